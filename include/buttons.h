@@ -0,0 +1,79 @@
+#ifndef BUTTONS_H
+#define BUTTONS_H
+
+#include <Arduino.h>
+
+// ============================================================================
+//   Button Timing Constants
+// ============================================================================
+#define DEBOUNCE_WINDOW   30    // Edges ignored after an accepted change (ms)
+#define LONG_PRESS        600   // Hold time before auto-repeat starts (ms)
+#define REPEAT_PERIOD     150   // Auto-repeat period (ms)
+#define FAST_SCROLL_AFTER 2000  // Hold time before scrolling by FAST_SCROLL_STEP (ms)
+#define FAST_SCROLL_STEP  10    // Alarms skipped per repeat when scrolling fast
+
+// Edge queue length, must be a power of 2
+#define BUTTON_QUEUE_SIZE 16
+
+// ============================================================================
+//   Button Indexes (bit of each button in the pressed mask)
+// ============================================================================
+enum ButtonIndex {
+    BTN_UP,     // UP_BTN
+    BTN_DOWN,   // DOWN_BTN
+    BTN_LOCK,   // LOCK_BTN
+    BTN_COUNT
+};
+
+// ============================================================================
+//   Button Edge
+//   Pushed by the GPIO interrupts into a single-producer/single-consumer queue.
+// ============================================================================
+struct ButtonEdge {
+    byte button;    // ButtonIndex
+    byte level;     // Pin level after the edge (LOW = pressed)
+    uint32_t time;  // Tick of the edge (ms)
+};
+
+// ============================================================================
+//   Function Prototypes
+// ============================================================================
+
+/**
+ * Attach the CHANGE interrupts of LOCK_BTN, UP_BTN and DOWN_BTN.
+ */
+void initButtons();
+
+/**
+ * Queue a button edge. Called by the GPIO interrupts; a simulated GPIO
+ * source can call it the same way. Never blocks, drops the edge if full.
+ */
+void IRAM_ATTR pushButtonEdge(byte button, byte level, uint32_t time);
+
+/**
+ * Consume the queued edges, debounce them and produce presses and
+ * auto-repeats for isPressed().
+ */
+void readBtns();
+
+/**
+ * Check if a button was pressed or auto-repeated by the last readBtns().
+ * @param btn Button pin number
+ * @return true if pressed, false otherwise
+ */
+boolean isPressed(uint8_t btn);
+
+/**
+ * Number of alarms to scroll for the current press of a button:
+ * 1, or FAST_SCROLL_STEP once the button is held long enough.
+ * @param btn Button pin number
+ */
+byte scrollStep(uint8_t btn);
+
+/**
+ * Milliseconds until readBtns() has work to do without a new edge
+ * (settling or auto-repeat), NO_DEADLINE if none.
+ */
+uint32_t buttonsTimeLeft();
+
+#endif
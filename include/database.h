@@ -1,12 +1,18 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
+#include <stdint.h>
+
 // ============================================================================
 //   GENERAL CONSTANTS
 // ============================================================================
 
 // Maximum number of alarms that can be stored
-#define MAX_ALARMS      40
+#define MAX_ALARMS      1024
+
+// Alarms are stored and transmitted in pages of packed alarms
+#define ALARMS_PAGE_SIZE 32
+#define ALARMS_PAGES(n)  (((n) + ALARMS_PAGE_SIZE - 1) / ALARMS_PAGE_SIZE)
 
 // Maximum lengths for stored eeprom
 #define MAX_DESCRIPTION_LEN 100
@@ -17,8 +23,24 @@
 #define DB_NAME "OpentimerDB"
 
 // ============================================================================
-//   STORAGE KEYS (EEPROM / Preferences / Flash)
-//   → Each key identifies a stored element.
+//   STORAGE RECORD
+//   → The settings are stored as one versioned blob: a header with a
+//     CRC-16, the settings, and the slot and generation of each alarm page.
+//   → Each page of ALARMS_PAGE_SIZE alarms is a blob of its own, with two
+//     slots. A changed page is written to the free slot, then the record
+//     blob: that single write commits the change, so a power cut leaves
+//     either the old or the new configuration.
+//   → An edit rewrites the pages it touched and the record, not the table.
+// ============================================================================
+#define RECORD_KEY           "record"
+#define RECORD_PAGE_KEY      "page%u.%u" // Page number, slot (0 or 1)
+#define RECORD_MAGIC         0x544F // "OT"
+#define RECORD_VERSION       2
+#define RECORD_PAGES         ALARMS_PAGES(MAX_ALARMS)
+
+// ============================================================================
+//   LEGACY STORAGE KEYS (EEPROM / Preferences / Flash)
+//   → One key per element. Only read once, to migrate to the record.
 // ============================================================================
 
 // Program type (mode or configuration)
@@ -27,9 +49,12 @@
 // Number of alarms stored
 #define NBR_ALARMS_KEY       "nb"
 
-// Alarms array
+// Alarms array (unpacked format)
 #define ALARMS_KEY           "alarms"
 
+// One page of packed alarms, suffixed with the page number ("alarms0", "alarms1", ...)
+#define ALARMS_PAGE_KEY      "alarms%u"
+
 // Password
 #define PASSWORD_KEY         "passwd"
 
@@ -50,22 +75,24 @@
 //   STORAGE FUNCTION PROTOTYPES
 // ============================================================================
 
-bool storeAlarms();
-bool getAlarms();
-
-bool storePassword();
-bool getPassword();
-
-bool storeDescription();
-bool getDescription();
-
-bool storeAuthor();
-bool getAuthor();
-
-bool storeState();
-bool getState();
-
-bool storeProgramType();
-bool getProgramType();
+/**
+ * Load eeprom from the stored record and compile the schedule.
+ * Migrates the legacy keys if there is no valid record (NVS must be open
+ * read-write).
+ * @return false if neither the record nor the legacy keys could be read
+ */
+bool loadRecord();
+
+/**
+ * Mark the alarms [first, last) as changed: the next storeRecord() writes
+ * the pages holding them.
+ */
+void markAlarmsDirty(uint16_t first, uint16_t last);
+
+/**
+ * Store eeprom: the changed alarm pages, then the record that commits them.
+ * @return false if a write failed; the last committed record stays valid
+ */
+bool storeRecord();
 
 #endif
@@ -5,14 +5,55 @@
 #include <Arduino.h>
 
 // ============================================================================
-//   Alarm structure
-//   Represents a single alarm entry with time, duration, and active days.
+//   Packed Alarm
+//   Each alarm is a single 32-bit word, stored and transmitted little-endian:
+//     bits  0–10  minute of the day (0–1439)
+//     bit   11    alarm state (1 = active)
+//     bits 12–18  active days (bit 12 = Sat ... bit 18 = Sun)
+//     bits 19–25  duration in seconds (0–99), or relay state for PRGII
+//     bits 26–31  reserved, always 0
+//   Bits 11–18 keep the layout of the former `days` byte (Sun..Sat|State).
 // ============================================================================
-struct Alarm {
-  byte hour;      // Hour of the alarm (0–23)
-  byte minute;    // Minute of the alarm (0–59)
-  byte duration;  // Duration of the alarm (in seconds)
-  byte days;      // Bitmask representing active days and state (e.g., 0b0111110 for Sun-Mon–Tue-Wed-Thu-Fri-Sat-State)
+typedef uint32_t Alarm;
+
+#define ALARM_MINUTE_MASK   0x7FFUL
+#define ALARM_DAYS_SHIFT    11
+#define ALARM_DURATION_SHIFT 19
+#define ALARM_RESERVED_MASK 0xFC000000UL
+
+inline uint16_t alarmMinuteOfDay(Alarm alarm) { return alarm & ALARM_MINUTE_MASK; }
+inline byte alarmHour(Alarm alarm) { return alarmMinuteOfDay(alarm) / 60; }
+inline byte alarmMinute(Alarm alarm) { return alarmMinuteOfDay(alarm) % 60; }
+inline byte alarmDays(Alarm alarm) { return (alarm >> ALARM_DAYS_SHIFT) & 0xFF; }
+inline bool alarmActive(Alarm alarm) { return bitRead(alarmDays(alarm), 0); }
+inline byte alarmDuration(Alarm alarm) { return (alarm >> ALARM_DURATION_SHIFT) & 0x7F; }
+
+inline Alarm packAlarm(byte hour, byte minute, byte duration, byte days) {
+  return (uint32_t)(hour * 60 + minute) |
+         (uint32_t)days << ALARM_DAYS_SHIFT |
+         (uint32_t)duration << ALARM_DURATION_SHIFT;
+}
+
+// Same limits as the unpacked upload: minute of day < 1440, duration < 100
+inline bool isAlarmValid(Alarm alarm) {
+  return alarmMinuteOfDay(alarm) < 1440 && alarmDuration(alarm) < 100 &&
+         (alarm & ALARM_RESERVED_MASK) == 0;
+}
+
+// ============================================================================
+//   Clock Time
+//   Date, time and temperature read from the DS3231 at one instant.
+// ============================================================================
+struct ClockTime {
+  byte hour;          // 0–23
+  byte minute;        // 0–59
+  byte second;        // 0–59
+  byte day;           // Day of the month (1–31)
+  byte month;         // 1–12
+  byte dayOfWeek;     // 1 = Sun ... 7 = Sat
+  byte temperature;   // Rounded temperature (°C)
+  unsigned int year;  // Full year
+  uint32_t tick;      // Tick at which this time was valid
 };
 
 // ============================================================================
@@ -38,7 +79,7 @@ struct EEPROMData {
   byte programType;
 
   // Number of alarms currently stored
-  byte alarmCount;
+  uint16_t alarmCount;
 
   // Effective length of the program description
   byte descriptionLength;
@@ -15,6 +15,15 @@
 #define D6 18
 #define D7 19
 
+// ============================================================================
+//   LCD Geometry
+// ============================================================================
+#define LCD_COLS 16
+#define LCD_ROWS 2
+
+// Never rendered: marks the glass cells whose content is unknown
+#define GLASS_UNKNOWN ((char)0xFF)
+
 // ============================================================================
 //   Days of the week abbreviations
 // ============================================================================
@@ -71,5 +80,68 @@ const uint32_t ABCD = (1 << A) | (1 << B) | (1 << C) | (1 << D);
 void displayAlarm();   // Display alarm info on the LCD
 void refreshHome();    // Refresh the main/home screen
 void initHome();       // Initialize home screen layout
+void restoreScreen();  // Redraw the screen of the current menu
+
+// ============================================================================
+//   LCD Framebuffer
+// ============================================================================
+void clearFrame();                           // Fill the framebuffer with spaces, cursor at 0,0
+void frameCursor(byte col, byte row);        // Move the framebuffer cursor
+void frameWrite(char c);                     // Write one character (custom chars included)
+void framePrint(const char *text);           // Write a string, clipped at the end of the row
+void framePrint(unsigned int value, byte digits); // Write a number, zero padded to `digits`
+
+/**
+ * Hand the framebuffer over to the LCD task. Never waits on the LCD.
+ */
+void flushFrame();
+
+/**
+ * Draw the latest flushed frame, sending only the cells that differ from
+ * the LCD. Called by the LCD task only.
+ */
+void serviceLcd();
+
+/**
+ * Forget what the LCD shows so the next flushFrame() redraws every cell.
+ * Call after writing to the LCD directly.
+ */
+void invalidateFrame();
+
+/**
+ * Show a message over the current screen. It expires by itself after
+ * MSG_DELAY and the current menu is redrawn.
+ * @param top First line (16 chars)
+ * @param bottom Second line (16 chars), or NULL
+ */
+void showMessage(const char *top, const char *bottom = NULL);
+
+/**
+ * Check if a message is currently shown over the menu.
+ */
+bool isMessageShown();
+
+/**
+ * Expire the current message when its time is up. Called by the UI task.
+ */
+void serviceMessage();
+
+/**
+ * Milliseconds until the current message expires, NO_DEADLINE if none.
+ */
+uint32_t messageTimeLeft();
+
+/**
+ * Milliseconds until the home screen clock shows the next second,
+ * NO_DEADLINE if the home screen is not shown.
+ */
+uint32_t homeTimeLeft();
+
+/**
+ * Set the countdown shown on the 7-segment display and precompute the
+ * register masks used by the display ISR.
+ * @param value Duration in seconds (0-99)
+ */
+void setDuration(byte value);
 
 #endif
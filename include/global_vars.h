@@ -2,9 +2,12 @@
 #define VARS_H
 
 #include "BluetoothSerial.h"
+#include "buttons.h"
 #include "database.h"
 #include "datatypes.h"
 #include "display.h"
+#include "schedule.h"
+#include "tasks.h"
 #include "utils.h"
 #include <DS3231.h>
 #include <LiquidCrystal.h>
@@ -26,15 +29,6 @@ extern LiquidCrystal lcd;
 // Current index of the selected alarm
 extern int alarmIndex;
 
-// Current time and date (hour, minute, second, day, month, day of week)
-extern byte hourNow, minuteNow, secondNow, dayNow, monthNow, dayOfWeekNow, temperatureNow;
-
-// Previous time and date (for detecting changes)
-extern byte prevHour, prevMinute, prevSecond, prevDay, prevMonth, prevDayOfWeek, prevTemperature;
-
-// Current and previous year
-extern unsigned int yearNow, prevYear;
-
 // RTC object for DS3231 real-time clock
 extern DS3231 myRTC;
 
@@ -50,6 +44,16 @@ extern bool pmFlag;    // true = PM, false = AM
 // Alarm duration (in seconds)
 extern byte duration;
 
+// 7-segment masks applied by the display ISR, index = firstDigit
+extern volatile uint32_t segmentSet[2];
+extern volatile uint32_t segmentClear[2];
+
+// Milliseconds elapsed since boot, counted by the 7-segment ISR
+extern volatile uint32_t ticks;
+
+// Seconds the scheduler ran late by and had to catch up since boot
+extern uint32_t missedTicks;
+
 // Preferences object for persistent storage (EEPROM/Flash)
 extern Preferences preferences;
 
@@ -59,7 +63,7 @@ extern BluetoothSerial SerialBT;
 // Current menu displayed on the LCD
 extern MenuLcd currentMenu;
 
-// Lock timer (used for display)
-extern byte lockTime;
+// Lock timer: millis() of the last user action in the ALARMS menu
+extern unsigned long lockTime;
 
 #endif
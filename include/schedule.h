@@ -0,0 +1,109 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include "database.h"
+#include "datatypes.h"
+#include <Arduino.h>
+
+// ============================================================================
+//   Weekly Timeline Constants
+// ============================================================================
+#define MINUTES_PER_DAY   1440
+#define MINUTES_PER_WEEK  10080
+
+// Number of 32-bit words needed for one bit per minute of the week
+#define WEEK_WORDS        (MINUTES_PER_WEEK / 32)
+
+// At most one event per alarm and per day, and never more than one per minute
+#define MAX_EVENTS        (MAX_ALARMS * 7 < MINUTES_PER_WEEK ? MAX_ALARMS * 7 : MINUTES_PER_WEEK)
+
+// Returned when no alarm starts at the requested minute
+#define NO_ALARM          -1
+
+// ============================================================================
+//   Compiled Schedule
+//   Precomputed weekly timeline built from eeprom.alarms.
+//   → bitmap has one bit per minute of the week (Sunday 00:00 = minute 0),
+//     set when an active alarm starts at that minute.
+//   → events holds the alarm index of every set bit, in minute order. When
+//     several alarms share a minute only the first one of the table is kept,
+//     as the former linear scan stopped on the first match.
+//   → alarms is the copy of eeprom.alarms the timeline was built from, and
+//     state and programType those of eeprom, so the alarm and UI tasks never
+//     read the configuration being edited.
+//
+//   Two buffers: compileSchedule() builds the inactive one and publishes it
+//   with a single atomic index store. Readers take no lock; a buffer is only
+//   rebuilt once the readers that acquired it have released it.
+// ============================================================================
+struct Schedule {
+  Alarm alarms[MAX_ALARMS];
+  uint16_t alarmCount;
+  byte state;             // Alarms only fire when set
+  byte programType;       // 0: countdown of the alarm duration, 1: relay on/off
+
+  uint32_t bitmap[WEEK_WORDS];
+  uint16_t events[MAX_EVENTS];
+  uint16_t eventCount;
+
+  uint16_t version;       // Incremented by each compileSchedule()
+};
+
+// ============================================================================
+//   Function Prototypes
+// ============================================================================
+
+/**
+ * Rebuild the weekly timeline from eeprom.alarms and publish it.
+ * Must be called every time the alarm table, the state or the program type
+ * is loaded or modified, by the owner of eeprom (setup, then the protocol
+ * task). Waits if a reader still holds the buffer being rebuilt.
+ */
+void compileSchedule();
+
+/**
+ * Get the published schedule. It does not change until released; keep it
+ * for the duration of one lookup or one screen, not longer.
+ */
+const Schedule *acquireSchedule();
+
+/**
+ * Release a schedule returned by acquireSchedule().
+ */
+void releaseSchedule(const Schedule *table);
+
+/**
+ * Version of the published schedule.
+ */
+uint16_t scheduleVersion();
+
+/**
+ * Number of alarms in the published schedule.
+ */
+uint16_t scheduledAlarmCount();
+
+/**
+ * State and program type of the published schedule.
+ */
+byte scheduledState();
+byte scheduledProgramType();
+
+/**
+ * Convert a DS3231 day of week (1 = Sun ... 7 = Sat) and a time to a minute of the week.
+ */
+uint16_t minuteOfWeek(byte dayOfWeek, byte hour, byte minute);
+
+/**
+ * Get the alarm starting at the given minute of the week.
+ * Alarm task only: moves the lookup cursor.
+ * @return Index in table.alarms, or NO_ALARM
+ */
+int scheduledAlarm(const Schedule &table, uint16_t minute);
+
+/**
+ * Get the minute of the week of the next event at or after the given minute.
+ * @return Minute of the week, or MINUTES_PER_WEEK if the schedule is empty
+ */
+uint16_t nextEventMinute(const Schedule &table, uint16_t minute);
+
+#endif
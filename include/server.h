@@ -1,6 +1,8 @@
 #ifndef REQUEST_H
 #define REQUEST_H
 
+#include "transport.h"
+
 // ============================================================================
 //   Request Codes for Bluetooth Communication
 // ============================================================================
@@ -42,9 +44,57 @@ enum RequestCodes {
     SET_PROGRAM_TYPE,    // Set program type
     GET_PROGRAM_TYPE,    // Get program type
     DISCONNECTED,        // Client disconnected
-    ERROR                // General error
+    ERROR,               // General error
+    GET_ALARMS_PAGE,     // Request one page of packed alarms
+    SET_ALARMS_PAGE,     // Set one page of packed alarms
+    GET_MISSED_TICKS,    // Request the number of seconds caught up by the scheduler
+    SET_MISSED_TICKS,    // Send the number of seconds caught up by the scheduler
+    GET_ONSET_LATENCY,   // Request the worst alarm onset latency
+    SET_ONSET_LATENCY,   // Send the worst alarm onset latency
+    GET_CLOCK_AGE,       // Request the age of the clock snapshot used by the request
+    SET_CLOCK_AGE,       // Send the age of the clock snapshot used by the request
+    SET_PROTOCOL_VERSION,// Send the protocol version accepted on CONNECTED
+    UPDATE_ALARMS,       // Overwrite a range of packed alarms
+    INSERT_ALARMS,       // Insert packed alarms before an index
+    DELETE_ALARMS,       // Delete a range of alarms
+    GET_DATETIME,        // Request date and time in one record
+    SET_DATETIME,        // Set or send date and time in one record
+    GET_STATUS,          // Request the device status record
+    SET_STATUS,          // Send the device status record
+    CRC_ERROR,           // Request dropped: CRC mismatch (v3)
+    GET_CHALLENGE,       // Request a login challenge
+    SET_CHALLENGE,       // Send a login challenge
+    POST_LOGIN,          // Answer the challenge to open a session
+    SET_SESSION,         // Send the session token (0 if the login failed)
+    POST_SESSION,        // Authenticate the request with the session token
+    SUBSCRIBE,           // Choose the events pushed by the device, echoed back
+    EVENT,               // Event pushed by the device
+    REQUEST_CODE_COUNT   // Number of codes, keep last
 };
 
+// ============================================================================
+//   Event Subscriptions (SUBSCRIBE mask)
+// ============================================================================
+#define SUBSCRIBE_CLOCK_SECOND  0x01  // EVENT_CLOCK every second
+#define SUBSCRIBE_CLOCK_MINUTE  0x02  // EVENT_CLOCK every minute
+#define SUBSCRIBE_STATE         0x04  // EVENT_STATE when the program state changes
+#define SUBSCRIBE_ALARMS        0x08  // EVENT_ALARM_FIRED and EVENT_ALARM_ENDED
+#define SUBSCRIBE_RELAY         0x10  // EVENT_RELAY on relay transitions
+
+// v3 sequence number of pushed events; clients should not use it for requests
+#define EVENT_SEQ 0xFF
+
+// ============================================================================
+//   Protocol Versions
+// ============================================================================
+#define PROTOCOL_V1 1            // 1-byte lengths, single response frame
+#define PROTOCOL_V2 2            // 2-byte lengths, streamed responses
+#define PROTOCOL_V3 3            // v2 + sequence numbers and CRC-16, pipelined requests
+
+// Sent right after CONNECTED by clients that speak v2 or v3. Never valid opcodes.
+#define PROTOCOL_V2_MAGIC 0xF2
+#define PROTOCOL_V3_MAGIC 0xF3
+
 // ============================================================================
 //   Password Response Codes
 // ============================================================================
@@ -61,30 +111,33 @@ enum PasswordResponse {
 // ============================================================================
 
 /**
- * Execute a Bluetooth request, update EEPROM and MEM_ADDR as needed.
+ * Add a link the protocol engine can serve. When no client is attached,
+ * the first registered transport that connects is served until it
+ * disconnects.
  */
-void execRequest();
+void registerTransport(Transport &transport);
 
 /**
- * Clear the serial receive buffer.
+ * Execute a Bluetooth request, update EEPROM and MEM_ADDR as needed.
  */
-void serialFlush();
+void execRequest();
 
 /**
- * Task function for FreeRTOS or loop execution.
- * @param parameter Pointer to task parameter (unused)
+ * Push the events the client subscribed to. Called by the protocol task
+ * between requests.
  */
-void taskFunction(void *parameter);
+void serviceEvents();
 
 /**
- * Disable request timeout handling.
+ * Clear the serial receive buffer.
  */
-void disableTimeout();
+void serialFlush();
 
 /**
- * Enable request timeout handling.
+ * Answer TIMEOUT and drop the pending request if it was not fully
+ * received in time.
  */
-void enableTimout();
+void checkTimeout();
 
 /**
  * Handle communication or processing errors.
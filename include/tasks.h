@@ -0,0 +1,109 @@
+#ifndef TASKS_H
+#define TASKS_H
+
+#include <Arduino.h>
+
+// ============================================================================
+//   Task Configuration
+//   → The alarm task has the highest priority and never touches the LCD or
+//     Bluetooth, so protocol or UI load cannot delay an alarm onset.
+//   → Only the LCD task writes to the LCD, at the lowest priority: the slow
+//     4-bit transfers never hold up the other tasks.
+//   → Bluetooth runs on core 0 with the ESP32 BT stack.
+// ============================================================================
+#define ALARM_TASK_PRIORITY     4
+#define PROTOCOL_TASK_PRIORITY  3
+#define UI_TASK_PRIORITY        2
+#define LCD_TASK_PRIORITY       1
+
+#define ALARM_TASK_CORE         1
+#define UI_TASK_CORE            1
+#define LCD_TASK_CORE           1
+#define PROTOCOL_TASK_CORE      0
+
+#define TASK_STACK_SIZE         4096  // Stack size of each task (bytes)
+#define PROTOCOL_PERIOD         5     // Bluetooth polling period (ms)
+#define UI_QUEUE_LENGTH         8     // Pending messages for the UI task
+#define EVENT_QUEUE_LENGTH      16    // Pending events for the protocol task
+
+// ============================================================================
+//   UI Message
+//   Sent by other tasks to have a message shown by the UI task.
+// ============================================================================
+struct UiMessage {
+  char top[17];         // First line
+  char bottom[17];      // Second line, empty if none
+  byte chirps;          // Number of chirps to play
+  uint16_t toneLength;  // Length of a single tone (ms), 0 if none
+};
+
+// ============================================================================
+//   Device Events
+//   Queued by the alarm and protocol tasks, pushed to subscribed clients by
+//   the protocol task. Clock and state are not queued: the protocol task
+//   compares them with what it last sent, so only the latest value is pushed.
+// ============================================================================
+enum EventTypes {
+    EVENT_CLOCK,         // [hour][minute][second]
+    EVENT_STATE,         // [state]
+    EVENT_ALARM_FIRED,   // [index low][index high]
+    EVENT_ALARM_ENDED,   // [index low][index high]
+    EVENT_RELAY,         // [1 = on, 0 = off]
+    EVENT_LOST           // [number of events dropped, saturated at 255]
+};
+
+struct Event {
+  byte type;            // EventTypes
+  uint16_t value;       // Alarm index or relay state
+};
+
+// ============================================================================
+//   Function Prototypes
+// ============================================================================
+
+/**
+ * Create the queues, locks and the alarm, UI, LCD and protocol tasks.
+ */
+void startTasks();
+
+/**
+ * Queue a message for the UI task. Never blocks: the message is dropped if
+ * the queue is full.
+ */
+void postMessage(const char *top, const char *bottom = NULL, byte chirps = 0, uint16_t toneLength = 0);
+
+/**
+ * Queue an event for the protocol task. Never blocks: when the queue is
+ * full the event is dropped and counted.
+ */
+void postEvent(byte type, uint16_t value);
+
+/**
+ * Take the next queued event.
+ * @return false if none is queued
+ */
+bool takeEvent(Event &event);
+
+/**
+ * Number of events dropped since the last call, saturated at 255.
+ */
+byte takeLostEvents();
+
+/**
+ * Wake the LCD task: a new frame was flushed.
+ */
+void notifyLcd();
+
+/**
+ * Wake the UI task: a button edge, a message or a menu change is waiting.
+ */
+void notifyUi();
+void IRAM_ATTR notifyUiFromIsr();
+
+/**
+ * Serialize access to the DS3231 between tasks.
+ */
+void lockRtc();
+void unlockRtc();
+
+#endif
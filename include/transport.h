@@ -0,0 +1,74 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "BluetoothSerial.h"
+#include <Arduino.h>
+
+// ============================================================================
+//   Transport Configuration
+// ============================================================================
+#define MAX_TRANSPORTS       3      // Links the protocol engine can serve
+#define STREAM_IDLE_TIMEOUT  30000  // Silence after which a stream link is released (ms)
+
+// ============================================================================
+//   Byte-Stream Transport
+//   The protocol engine only sees this interface, so the same request code
+//   serves Bluetooth or any other link (e.g. a UART on free pins, or a pty
+//   or a TCP socket in a host harness). One link is served at a time.
+// ============================================================================
+class Transport {
+  public:
+    virtual bool connected() = 0;   // A client is attached
+    virtual void close() {}         // The client sent DISCONNECTED
+    virtual int available() = 0;    // Bytes ready to be read
+    virtual size_t read(byte *buffer, size_t length) = 0;
+    virtual size_t write(const byte *buffer, size_t length) = 0;
+    virtual void flush() = 0;       // Push out what was written
+};
+
+// ============================================================================
+//   Arduino Stream Transport
+//   A UART has no link state: the link is considered open from the first
+//   received byte until the client sends DISCONNECTED or stays silent for
+//   STREAM_IDLE_TIMEOUT, so stray bytes cannot hold the engine for good.
+// ============================================================================
+class StreamTransport : public Transport {
+  public:
+    explicit StreamTransport(Stream &stream) : stream(stream) {}
+
+    bool connected() override {
+        if (stream.available() > 0) {
+            open = true;
+            lastReceived = millis();
+        } else if (open && millis() - lastReceived >= STREAM_IDLE_TIMEOUT) {
+            open = false;
+        }
+        return open;
+    }
+    void close() override { open = false; }
+    int available() override { return stream.available(); }
+    size_t read(byte *buffer, size_t length) override { return stream.readBytes(buffer, length); }
+    size_t write(const byte *buffer, size_t length) override { return stream.write(buffer, length); }
+    void flush() override { stream.flush(); }
+
+  protected:
+    Stream &stream;
+    bool open = false;
+    unsigned long lastReceived = 0; // millis() of the last byte seen
+};
+
+// ============================================================================
+//   Bluetooth SPP Transport
+//   Connected while a client is paired and attached.
+// ============================================================================
+class BluetoothTransport : public StreamTransport {
+  public:
+    explicit BluetoothTransport(BluetoothSerial &serial) : StreamTransport(serial), serial(serial) {}
+
+    bool connected() override { return serial.hasClient(); }
+
+  private:
+    BluetoothSerial &serial;
+};
+
+#endif
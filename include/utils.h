@@ -1,6 +1,7 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include "datatypes.h"
 #include <Arduino.h>
 
 // ============================================================================
@@ -25,19 +26,54 @@
 //   Timing Constants
 // ============================================================================
 #define MSG_DELAY 2000               // Message duration in milliseconds
-#define DEBOUNCE 300                 // Button debounce delay (ms)
+#define CLICK_LEN 100                // Button click tone duration (ms)
 #define DISPLAY_PERIOD_7SEGMENT 1    // 7-segment refresh period in ms
 #define BUZZER_FREQ 2000             // Buzzer frequency in Hz
+#define CHIRP_LEN 200                // Chirp duration (ms)
+#define CHIRP_PERIOD 300             // Delay between two chirps (ms)
 #define LOCK_TIME 20                 // Display unlock duration (seconds)
+#define MAX_SLEEP 3600000UL          // Longest wait between two scheduler runs (ms)
+#define NO_DEADLINE 0xFFFFFFFFUL     // Returned by the *TimeLeft() functions when nothing is pending
+#define RTC_SYNC_PERIOD 60           // Software clock resync with the DS3231 (seconds)
+#define TEMP_PERIOD 64               // Temperature read period, the DS3231 converts every 64 s (seconds)
+
+// ============================================================================
+//   DS3231 Registers
+// ============================================================================
+#define DS3231_ADDRESS 0x68          // I2C address
+#define DS3231_TIME_REG 0x00         // Seconds, first of the 7 time registers
 
 // ============================================================================
 //   Function Prototypes
 // ============================================================================
 
 /**
- * Read the state of buttons and update internal flags.
+ * CRC-16/CCITT-FALSE (polynomial 0x1021). Pass the previous result as `crc`
+ * to continue over several buffers.
+ */
+uint16_t crc16(const byte *data, size_t length, uint16_t crc = 0xFFFF);
+
+/**
+ * Schedule a series of short buzzer chirps without waiting for them.
+ * @param count Number of chirps
+ */
+void chirp(byte count);
+
+/**
+ * Play the scheduled chirps that are due. Called by the UI task.
  */
-void readBtns();
+void serviceBuzzer();
+
+/**
+ * Milliseconds until the next scheduled chirp, NO_DEADLINE if none.
+ */
+uint32_t chirpTimeLeft();
+
+/**
+ * Milliseconds until the ALARMS menu locks back to HOME, NO_DEADLINE if
+ * another menu is shown.
+ */
+uint32_t lockTimeLeft();
 
 /**
  * Handle menu navigation and selection logic.
@@ -45,21 +81,56 @@ void readBtns();
 void handleMenu();
 
 /**
- * Check if a button is currently pressed.
- * @param btn Button pin number
- * @return true if pressed, false otherwise
+ * Tell the UI task the alarm table was edited, so the alarm view is
+ * clamped to the new table and redrawn. Safe to call from any task.
  */
-boolean isPressed(uint8_t btn);
+void notifyAlarmsChanged();
 
 /**
- * Update the system time from RTC or internal counter.
+ * Take the current time for the scheduler (alarm task), resynchronizing
+ * the software clock first if it is due.
  */
 void updateTime();
 
+/**
+ * Read the RTC in one burst if RTC_SYNC_PERIOD has elapsed, the clock
+ * crossed midnight or resyncClock() was called, and the temperature every
+ * TEMP_PERIOD. Cheap when nothing is due. Safe to call from any task.
+ */
+void serviceClock();
+
+/**
+ * Force the next serviceClock() to read the RTC. Call after setting the RTC.
+ */
+void resyncClock();
+
+/**
+ * Write date and time to the RTC in one burst (24-hour mode) and resync
+ * the software clock. Fields must be valid; temperature and tick are ignored.
+ * @param time Year is the full year, as in ClockTime
+ * @return false if the I2C write failed
+ */
+bool setClock(const ClockTime &time);
+
+/**
+ * Number of days in a month of the Gregorian calendar.
+ * @param month 1-12, 31 is returned for any other value
+ * @param year Full year, for February
+ */
+byte daysInMonth(byte month, unsigned int year);
+
+/**
+ * Get the current time of the software clock: the last RTC burst advanced
+ * by the ticks elapsed since. Safe to call from any task, no I2C access.
+ * tick is the start of the current second; ticks - tick gives its age.
+ */
+ClockTime getClock();
+
 /**
  * Check alarms and trigger buzzer/relay if an alarm is due.
+ * @return true if an alarm was triggered
  */
-void checkAndTriggerAlarm();
+bool checkAndTriggerAlarm();
 
 /**
  * ISR for toggling the 7-segment display digits (fast refresh).
@@ -72,8 +143,21 @@ void IRAM_ATTR onSevenSegmentDisplayToggle();
 void initRelay();
 
 /**
- * Function to execute tasks every second (time-based updates).
+ * Run the events due now: alarm start and duration countdown.
+ * @return Milliseconds until the next due event, MAX_SLEEP at most
+ */
+uint32_t runScheduler();
+
+/**
+ * Ask the alarm task to run the scheduler now, because the schedule,
+ * the clock or the menu changed.
+ */
+void requestWakeup();
+
+/**
+ * Get the worst alarm onset latency measured since boot: time between the
+ * planned wakeup of the alarm task and the relay or countdown start (ms).
  */
-void everySecond();
+uint32_t getOnsetLatency();
 
 #endif
@@ -0,0 +1,146 @@
+#include "buttons.h"
+#include "global_vars.h"
+
+// ============================================================================
+//   Global Variables
+// ============================================================================
+const uint8_t buttonPins[BTN_COUNT] = {UP_BTN, DOWN_BTN, LOCK_BTN};
+
+ButtonEdge edgeQueue[BUTTON_QUEUE_SIZE];  // Written by the ISRs only
+volatile byte edgeHead = 0;               // Next slot written by the ISRs
+volatile byte edgeTail = 0;               // Next slot read by readBtns()
+volatile uint32_t droppedEdges = 0;       // Edges lost because the queue was full
+
+byte buttonsPressed;                   // Presses and repeats of the last readBtns()
+bool held[BTN_COUNT];                  // Debounced state (true = pressed)
+bool settled[BTN_COUNT] = {true, true, true}; // No edge left to reconcile
+uint32_t lastChange[BTN_COUNT];        // Tick of the last accepted change
+uint32_t lastEdge[BTN_COUNT];          // Tick of the last edge
+uint32_t pressTime[BTN_COUNT];         // Tick of the accepted press
+uint32_t nextRepeat[BTN_COUNT];        // Tick of the next auto-repeat
+
+// ============================================================================
+//   Helpers
+// ============================================================================
+static int buttonIndex(uint8_t btn) {
+    for (byte i = 0; i < BTN_COUNT; i++) {
+        if (buttonPins[i] == btn) return i;
+    }
+    return -1;
+}
+
+// digitalRead() lives in flash; read the input register directly from the ISRs
+static inline byte IRAM_ATTR pinLevel(uint8_t pin) {
+    return (REG_READ(GPIO_IN_REG) >> pin) & 1;
+}
+
+static void acceptChange(byte b, bool pressed, uint32_t time) {
+    held[b] = pressed;
+    lastChange[b] = time;
+    if (pressed) {
+        bitSet(buttonsPressed, b);
+        pressTime[b] = time;
+        nextRepeat[b] = time + LONG_PRESS;
+    }
+}
+
+// ============================================================================
+//   Interrupts
+// ============================================================================
+void IRAM_ATTR pushButtonEdge(byte button, byte level, uint32_t time) {
+    byte next = (edgeHead + 1) & (BUTTON_QUEUE_SIZE - 1);
+    if (next == edgeTail) {
+        droppedEdges = droppedEdges + 1; // Settling recovers the state
+        return;
+    }
+    edgeQueue[edgeHead] = {button, level, time};
+    edgeHead = next;
+    notifyUiFromIsr();
+}
+
+static void IRAM_ATTR onUpEdge() { pushButtonEdge(BTN_UP, pinLevel(UP_BTN), ticks); }
+static void IRAM_ATTR onDownEdge() { pushButtonEdge(BTN_DOWN, pinLevel(DOWN_BTN), ticks); }
+static void IRAM_ATTR onLockEdge() { pushButtonEdge(BTN_LOCK, pinLevel(LOCK_BTN), ticks); }
+
+void initButtons() {
+    attachInterrupt(digitalPinToInterrupt(UP_BTN), onUpEdge, CHANGE);
+    attachInterrupt(digitalPinToInterrupt(DOWN_BTN), onDownEdge, CHANGE);
+    attachInterrupt(digitalPinToInterrupt(LOCK_BTN), onLockEdge, CHANGE);
+}
+
+// ============================================================================
+//   Read Buttons
+//   → An edge changes the state only if DEBOUNCE_WINDOW has passed since the
+//     last accepted change; the bounces that follow are ignored.
+//   → Once no edge came for DEBOUNCE_WINDOW the pin is read back, so a state
+//     missed inside the window (or a dropped edge) is still picked up.
+//   → UP and DOWN auto-repeat after LONG_PRESS, every REPEAT_PERIOD.
+// ============================================================================
+void readBtns() {
+    buttonsPressed = 0b000;
+
+    while (edgeTail != edgeHead) {
+        ButtonEdge edge = edgeQueue[edgeTail];
+        edgeTail = (edgeTail + 1) & (BUTTON_QUEUE_SIZE - 1);
+
+        byte b = edge.button;
+        bool pressed = edge.level == LOW;
+        settled[b] = false;
+        lastEdge[b] = edge.time;
+
+        if (pressed != held[b] && edge.time - lastChange[b] >= DEBOUNCE_WINDOW) {
+            acceptChange(b, pressed, edge.time);
+        }
+    }
+
+    uint32_t now = ticks;
+    for (byte b = 0; b < BTN_COUNT; b++) {
+        if (!settled[b] && now - lastEdge[b] >= DEBOUNCE_WINDOW) {
+            settled[b] = true;
+            bool pressed = digitalRead(buttonPins[b]) == LOW;
+            if (pressed != held[b]) acceptChange(b, pressed, now);
+        }
+
+        if (held[b] && b != BTN_LOCK && (int32_t)(now - nextRepeat[b]) >= 0) {
+            bitSet(buttonsPressed, b);
+            nextRepeat[b] += REPEAT_PERIOD;
+        }
+    }
+}
+
+// ============================================================================
+//   Check if a Button is Pressed
+// ============================================================================
+boolean isPressed(uint8_t btn) {
+    int b = buttonIndex(btn);
+    return b >= 0 && bitRead(buttonsPressed, b);
+}
+
+// ============================================================================
+//   Scroll Step
+// ============================================================================
+byte scrollStep(uint8_t btn) {
+    int b = buttonIndex(btn);
+    if (b < 0 || !held[b]) return 1;
+    return ticks - pressTime[b] >= FAST_SCROLL_AFTER ? FAST_SCROLL_STEP : 1;
+}
+
+// ============================================================================
+//   Time to the Next Button Deadline
+// ============================================================================
+uint32_t buttonsTimeLeft() {
+    uint32_t now = ticks;
+    uint32_t left = NO_DEADLINE;
+
+    for (byte b = 0; b < BTN_COUNT; b++) {
+        if (!settled[b]) {
+            int32_t settle = lastEdge[b] + DEBOUNCE_WINDOW - now;
+            left = min<uint32_t>(left, settle > 0 ? settle : 0);
+        }
+        if (held[b] && b != BTN_LOCK) {
+            int32_t repeat = nextRepeat[b] - now;
+            left = min<uint32_t>(left, repeat > 0 ? repeat : 0);
+        }
+    }
+    return left;
+}
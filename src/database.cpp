@@ -1,104 +1,249 @@
 #include "database.h"
 #include "global_vars.h"
 #include <Arduino.h>
+#include <stddef.h>
 
 // ============================================================================
-//   Store Alarms in Preferences (EEPROM/Flash)
+//   Record Layout
+//   Fields are ordered so the structures have no implicit padding: every
+//   byte covered by a CRC is written explicitly.
 // ============================================================================
-bool storeAlarms() {
-    // Store number of alarms
-    if (preferences.putInt(NBR_ALARMS_KEY, eeprom.alarmCount) == 0)
-        return false;
+struct RecordHeader {
+  uint16_t magic;       // RECORD_MAGIC
+  byte version;         // RECORD_VERSION
+  byte reserved;
+  uint16_t length;      // Bytes following the header
+  uint16_t crc;         // CRC-16 of those bytes
+};
+
+struct Record {
+  RecordHeader header;
+
+  uint32_t generation;                    // Incremented by each storeRecord()
+  uint32_t pageSlots;                     // Bit n: slot holding page n
+  uint32_t pageGeneration[RECORD_PAGES];  // Generation page n was written with
+
+  uint16_t alarmCount;
+  byte programType;
+  byte state;
+  byte descriptionLength;
+  byte authorLength;
+  byte password[PASSWORD_LEN];
+  byte description[MAX_DESCRIPTION_LEN];
+  byte author[MAX_AUTHOR_LEN];
+  byte reserved;
+};
+
+// One page of alarms, only the used alarms of the last page are stored
+struct PageHeader {
+  uint32_t generation;  // Generation of the storeRecord() that wrote it
+  uint16_t crc;         // CRC-16 of the alarms
+  uint16_t reserved;
+};
+
+struct RecordPage {
+  PageHeader header;
+  Alarm alarms[ALARMS_PAGE_SIZE];
+};
+
+static_assert(RECORD_PAGES <= 32, "pageSlots has one bit per page");
+static_assert(sizeof(Record) == offsetof(Record, reserved) + 1, "Record must not be padded");
 
-    // Calculate total bytes for alarms (each alarm = 4 bytes)
-    size_t nbBytes = eeprom.alarmCount * 4;
+// ============================================================================
+//   Global Variables
+// ============================================================================
+Record record;        // Last record committed to NVS
+Record recordBuffer;  // Staging buffer of the record being read or written
+RecordPage pageBuffer; // Staging buffer of the page being read or written
+uint32_t dirtyPages;  // Pages changed since the last storeRecord()
 
-    // Store alarm array
-    if (preferences.putBytes(ALARMS_KEY, eeprom.alarms, nbBytes) != nbBytes)
-        return false;
+// ============================================================================
+//   Alarm Pages
+// ============================================================================
+static void pageKey(char *key, uint16_t page, byte slot) {
+    snprintf(key, 16, RECORD_PAGE_KEY, page, slot);
+}
 
-    return true;
+// Alarms of `page` in a table of `count` alarms
+static uint16_t pageLength(uint16_t page, uint16_t count) {
+    return min<uint16_t>(ALARMS_PAGE_SIZE, count - page * ALARMS_PAGE_SIZE);
 }
 
-// ============================================================================
-//   Retrieve Alarms from Preferences
-// ============================================================================
-bool getAlarms() {
-    int value = preferences.getInt(NBR_ALARMS_KEY, -1);
+void markAlarmsDirty(uint16_t first, uint16_t last) {
+    if (first >= last) return;
+    for (uint16_t page = first / ALARMS_PAGE_SIZE; page <= (last - 1) / ALARMS_PAGE_SIZE; page++) {
+        dirtyPages |= 1UL << page;
+    }
+}
 
-    if (value == -1 || value > MAX_ALARMS)
-        return false;
+static bool storePage(uint16_t page, byte slot, uint32_t generation) {
+    uint16_t n = pageLength(page, eeprom.alarmCount);
+    size_t nbBytes = sizeof(PageHeader) + n * sizeof(Alarm);
+    char key[16];
 
-    eeprom.alarmCount = value;
-    size_t nbBytes = eeprom.alarmCount * 4;
+    memcpy(pageBuffer.alarms, &eeprom.alarms[page * ALARMS_PAGE_SIZE], n * sizeof(Alarm));
+    pageBuffer.header.generation = generation;
+    pageBuffer.header.crc = crc16((const byte *)pageBuffer.alarms, n * sizeof(Alarm));
+    pageBuffer.header.reserved = 0;
 
-    if (preferences.getBytes(ALARMS_KEY, eeprom.alarms, nbBytes) != nbBytes)
+    pageKey(key, page, slot);
+    return preferences.putBytes(key, &pageBuffer, nbBytes) == nbBytes;
+}
+
+// The page must be the one the record committed: same length, generation and CRC
+static bool loadPage(uint16_t page) {
+    uint16_t n = pageLength(page, eeprom.alarmCount);
+    size_t nbBytes = sizeof(PageHeader) + n * sizeof(Alarm);
+    char key[16];
+
+    pageKey(key, page, (record.pageSlots >> page) & 1);
+    if (preferences.getBytes(key, &pageBuffer, sizeof(pageBuffer)) != nbBytes)
+        return false;
+    if (pageBuffer.header.generation != record.pageGeneration[page])
+        return false;
+    if (crc16((const byte *)pageBuffer.alarms, n * sizeof(Alarm)) != pageBuffer.header.crc)
         return false;
 
+    memcpy(&eeprom.alarms[page * ALARMS_PAGE_SIZE], pageBuffer.alarms, n * sizeof(Alarm));
     return true;
 }
 
 // ============================================================================
-//   Store Password
+//   Store Record
+//   Changed pages are written to the slot not in use, so the committed
+//   pages stay intact; the record write then switches to the new slots.
+//   Nothing changes on disk for the loader until that last write.
 // ============================================================================
-bool storePassword() {
-    return preferences.putBytes(PASSWORD_KEY, eeprom.password, PASSWORD_LEN) == PASSWORD_LEN;
+bool storeRecord() {
+    // Only the used alarms of the last page are stored: its length follows the count
+    if (eeprom.alarmCount != record.alarmCount && eeprom.alarmCount % ALARMS_PAGE_SIZE)
+        markAlarmsDirty(eeprom.alarmCount - 1, eeprom.alarmCount);
+
+    recordBuffer = record;
+    recordBuffer.generation = record.generation + 1;
+
+    for (uint16_t page = 0; page < ALARMS_PAGES(eeprom.alarmCount); page++) {
+        if (!((dirtyPages >> page) & 1)) continue;
+
+        byte slot = !((record.pageSlots >> page) & 1);
+        if (!storePage(page, slot, recordBuffer.generation)) return false;
+        recordBuffer.pageSlots ^= 1UL << page;
+        recordBuffer.pageGeneration[page] = recordBuffer.generation;
+    }
+
+    recordBuffer.alarmCount = eeprom.alarmCount;
+    recordBuffer.programType = eeprom.programType;
+    recordBuffer.state = eeprom.state;
+    recordBuffer.descriptionLength = eeprom.descriptionLength;
+    recordBuffer.authorLength = eeprom.authorLength;
+    memcpy(recordBuffer.password, eeprom.password, PASSWORD_LEN);
+    memcpy(recordBuffer.description, eeprom.description, MAX_DESCRIPTION_LEN);
+    memcpy(recordBuffer.author, eeprom.author, MAX_AUTHOR_LEN);
+    recordBuffer.reserved = 0;
+
+    uint16_t length = sizeof(Record) - sizeof(RecordHeader);
+    recordBuffer.header.magic = RECORD_MAGIC;
+    recordBuffer.header.version = RECORD_VERSION;
+    recordBuffer.header.reserved = 0;
+    recordBuffer.header.length = length;
+    recordBuffer.header.crc = crc16((const byte *)&recordBuffer + sizeof(RecordHeader), length);
+
+    if (preferences.putBytes(RECORD_KEY, &recordBuffer, sizeof(Record)) != sizeof(Record))
+        return false;
+
+    record = recordBuffer;
+    dirtyPages = 0;
+    return true;
 }
 
 // ============================================================================
-//   Retrieve Password
+//   Check the Record read in the staging buffer
 // ============================================================================
-bool getPassword() {
-    return preferences.getBytes(PASSWORD_KEY, eeprom.password, PASSWORD_LEN) == PASSWORD_LEN;
+static bool isRecordValid(size_t nbBytes) {
+    const RecordHeader &header = recordBuffer.header;
+
+    if (nbBytes != sizeof(Record))
+        return false;
+    if (header.magic != RECORD_MAGIC || header.version != RECORD_VERSION)
+        return false;
+    if (header.length != sizeof(Record) - sizeof(RecordHeader))
+        return false;
+    if (crc16((const byte *)&recordBuffer + sizeof(RecordHeader), header.length) != header.crc)
+        return false;
+
+    return recordBuffer.alarmCount <= MAX_ALARMS &&
+           recordBuffer.descriptionLength <= MAX_DESCRIPTION_LEN &&
+           recordBuffer.authorLength <= MAX_AUTHOR_LEN;
 }
 
 // ============================================================================
-//   Store Program Description
+//   Legacy Keys
+//   One key per element, read once to build the first record.
 // ============================================================================
-bool storeDescription() {
-    if (preferences.putInt(DESCRIPTION_LEN_KEY, eeprom.descriptionLength) == 0)
-        return false;
+static void alarmsPageKey(char *key, uint16_t page) {
+    snprintf(key, 16, ALARMS_PAGE_KEY, page);
+}
 
-    if (preferences.putBytes(DESCRIPTION_KEY, eeprom.description, eeprom.descriptionLength) != eeprom.descriptionLength)
+// Each alarm was 4 bytes: hour, minute, duration, days
+static bool getUnpackedAlarms() {
+    size_t nbBytes = eeprom.alarmCount * 4;
+
+    if (preferences.getBytes(ALARMS_KEY, eeprom.alarms, nbBytes) != nbBytes)
         return false;
 
+    // Entries have the same size, convert them in place
+    for (uint16_t i = 0; i < eeprom.alarmCount; i++) {
+        const byte *raw = (const byte *)&eeprom.alarms[i];
+        byte hour = raw[0], minute = raw[1], duration = raw[2], days = raw[3];
+        eeprom.alarms[i] = packAlarm(hour, minute, duration, days);
+    }
     return true;
 }
 
-// ============================================================================
-//   Retrieve Program Description
-// ============================================================================
-bool getDescription() {
-    int value = preferences.getInt(DESCRIPTION_LEN_KEY, -1);
+static bool getAlarms() {
+    int value = preferences.getInt(NBR_ALARMS_KEY, -1);
 
-    if (value == -1 || value > MAX_DESCRIPTION_LEN)
+    if (value == -1 || value > MAX_ALARMS)
         return false;
 
-    eeprom.descriptionLength = value;
+    eeprom.alarmCount = value;
 
-    if (preferences.getBytes(DESCRIPTION_KEY, eeprom.description, value) != value)
-        return false;
+    char key[16];
+    alarmsPageKey(key, 0);
+
+    if (value > 0 && !preferences.isKey(key) && preferences.isKey(ALARMS_KEY))
+        return getUnpackedAlarms();
 
+    for (uint16_t page = 0; page < ALARMS_PAGES(eeprom.alarmCount); page++) {
+        uint16_t first = page * ALARMS_PAGE_SIZE;
+        size_t nbBytes = min<uint16_t>(ALARMS_PAGE_SIZE, eeprom.alarmCount - first) * sizeof(Alarm);
+
+        alarmsPageKey(key, page);
+        if (preferences.getBytes(key, &eeprom.alarms[first], nbBytes) != nbBytes)
+            return false;
+    }
     return true;
 }
 
-// ============================================================================
-//   Store Author Name
-// ============================================================================
-bool storeAuthor() {
-    if (preferences.putInt(AUTHOR_LEN_KEY, eeprom.authorLength) == 0)
+static bool getPassword() {
+    return preferences.getBytes(PASSWORD_KEY, eeprom.password, PASSWORD_LEN) == PASSWORD_LEN;
+}
+
+static bool getDescription() {
+    int value = preferences.getInt(DESCRIPTION_LEN_KEY, -1);
+
+    if (value == -1 || value > MAX_DESCRIPTION_LEN)
         return false;
 
-    if (preferences.putBytes(AUTHOR_KEY, eeprom.author, eeprom.authorLength) != eeprom.authorLength)
+    eeprom.descriptionLength = value;
+
+    if (preferences.getBytes(DESCRIPTION_KEY, eeprom.description, value) != (size_t)value)
         return false;
 
     return true;
 }
 
-// ============================================================================
-//   Retrieve Author Name
-// ============================================================================
-bool getAuthor() {
+static bool getAuthor() {
     int value = preferences.getInt(AUTHOR_LEN_KEY, -1);
 
     if (value == -1 || value > MAX_AUTHOR_LEN)
@@ -106,23 +251,13 @@ bool getAuthor() {
 
     eeprom.authorLength = value;
 
-    if (preferences.getBytes(AUTHOR_KEY, eeprom.author, value) != value)
+    if (preferences.getBytes(AUTHOR_KEY, eeprom.author, value) != (size_t)value)
         return false;
 
     return true;
 }
 
-// ============================================================================
-//   Store Program AlarmState
-// ============================================================================
-bool storeState() {
-    return preferences.putInt(STATE_KEY, eeprom.state) != 0;
-}
-
-// ============================================================================
-//   Retrieve Program AlarmState
-// ============================================================================
-bool getState() {
+static bool getState() {
     int value = preferences.getInt(STATE_KEY, -1);
 
     if (value == -1 || value > 255)
@@ -132,17 +267,7 @@ bool getState() {
     return true;
 }
 
-// ============================================================================
-//   Store Program Type
-// ============================================================================
-bool storeProgramType() {
-    return preferences.putInt(PROGRAM_TYPE_KEY, eeprom.programType) != 0;
-}
-
-// ============================================================================
-//   Retrieve Program Type
-// ============================================================================
-bool getProgramType() {
+static bool getProgramType() {
     int value = preferences.getInt(PROGRAM_TYPE_KEY, -1);
 
     if (value == -1 || value > 255)
@@ -151,3 +276,57 @@ bool getProgramType() {
     eeprom.programType = value;
     return true;
 }
+
+static void removeLegacyKeys() {
+    char key[16];
+    for (uint16_t page = 0; page < ALARMS_PAGES(eeprom.alarmCount); page++) {
+        alarmsPageKey(key, page);
+        preferences.remove(key);
+    }
+
+    const char *keys[] = {PROGRAM_TYPE_KEY, NBR_ALARMS_KEY, ALARMS_KEY, PASSWORD_KEY, DESCRIPTION_LEN_KEY,
+                          DESCRIPTION_KEY, AUTHOR_LEN_KEY, AUTHOR_KEY, STATE_KEY};
+    for (byte i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        preferences.remove(keys[i]);
+    }
+}
+
+// ============================================================================
+//   Load Record
+// ============================================================================
+bool loadRecord() {
+    size_t nbBytes = preferences.getBytes(RECORD_KEY, &recordBuffer, sizeof(recordBuffer));
+    bool ok = true;
+
+    if (isRecordValid(nbBytes)) {
+        record = recordBuffer;
+        eeprom.alarmCount = record.alarmCount;
+        eeprom.programType = record.programType;
+        eeprom.state = record.state;
+        eeprom.descriptionLength = record.descriptionLength;
+        eeprom.authorLength = record.authorLength;
+        memcpy(eeprom.password, record.password, PASSWORD_LEN);
+        memcpy(eeprom.description, record.description, MAX_DESCRIPTION_LEN);
+        memcpy(eeprom.author, record.author, MAX_AUTHOR_LEN);
+
+        // A bad page keeps the alarms before it
+        for (uint16_t page = 0; page < ALARMS_PAGES(record.alarmCount); page++) {
+            if (!loadPage(page)) {
+                eeprom.alarmCount = page * ALARMS_PAGE_SIZE;
+                ok = false;
+                break;
+            }
+        }
+    } else {
+        // First boot after the update: the legacy keys become the record.
+        // Every getter runs, so what can be read is kept even if one fails.
+        ok = getProgramType() & getAlarms() & getDescription() & getAuthor() & getPassword() & getState();
+        if (ok) {
+            markAlarmsDirty(0, eeprom.alarmCount);
+            if (storeRecord()) removeLegacyKeys();
+        }
+    }
+
+    compileSchedule();
+    return ok;
+}
@@ -2,102 +2,158 @@
 #include "global_vars.h"
 
 // ============================================================================
-//   Initialize the Home Screen
+//   Global Variables
+// ============================================================================
+bool messageShown;          // A message is shown over the current menu
+unsigned long messageTime;  // millis() when the message was shown
+
+char frame[LCD_ROWS][LCD_COLS];   // Shadow framebuffer the screens render into (UI task)
+char pending[LCD_ROWS][LCD_COLS]; // Latest flushed frame, waiting for the LCD task
+char glass[LCD_ROWS][LCD_COLS];   // What the LCD currently shows (LCD task)
+byte frameCol, frameRow;          // Framebuffer cursor
+volatile uint32_t frameSeq;       // Incremented by each flushFrame()
+portMUX_TYPE frameMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ============================================================================
+//   LCD Framebuffer
+//   Screens draw into frame[] without touching the LCD. flushFrame() hands
+//   a copy to the LCD task and returns at once; the LCD task sends only the
+//   cells that differ from glass[]. Changed cells close to each other are
+//   sent as one run: a cursor set costs as much as rewriting one unchanged
+//   cell.
+// ============================================================================
+void invalidateFrame() {
+    memset(glass, GLASS_UNKNOWN, sizeof(glass));
+}
+
+void clearFrame() {
+    memset(frame, ' ', sizeof(frame));
+    frameCol = frameRow = 0;
+}
+
+void frameCursor(byte col, byte row) {
+    frameCol = col;
+    frameRow = row;
+}
+
+void frameWrite(char c) {
+    if (frameCol >= LCD_COLS || frameRow >= LCD_ROWS) return;
+    frame[frameRow][frameCol++] = c;
+}
+
+void framePrint(const char *text) {
+    while (*text != '\0') frameWrite(*text++);
+}
+
+void framePrint(unsigned int value, byte digits) {
+    frameCol += digits;
+    for (byte i = 1; i <= digits; i++) {
+        if (frameCol - i < LCD_COLS && frameRow < LCD_ROWS) {
+            frame[frameRow][frameCol - i] = '0' + value % 10;
+        }
+        value /= 10;
+    }
+}
+
+void flushFrame() {
+    portENTER_CRITICAL(&frameMux);
+    memcpy(pending, frame, sizeof(pending));
+    frameSeq = frameSeq + 1;
+    portEXIT_CRITICAL(&frameMux);
+
+    notifyLcd();
+}
+
+// Send the changed cells of `target`; gives up as soon as a newer frame is flushed
+static bool drawFrame(const char target[LCD_ROWS][LCD_COLS], uint32_t seq) {
+    for (byte row = 0; row < LCD_ROWS; row++) {
+        byte col = 0;
+        while (col < LCD_COLS) {
+            if (target[row][col] == glass[row][col]) { col++; continue; }
+            if (frameSeq != seq) return false;
+
+            // Extend the run while the next change is at most one cell away
+            byte end = col + 1;
+            for (byte next = end; next < LCD_COLS && next <= end + 1; next++) {
+                if (target[row][next] != glass[row][next]) end = next + 1;
+            }
+
+            lcd.setCursor(col, row);
+            for (; col < end; col++) {
+                lcd.write((uint8_t)target[row][col]);
+                glass[row][col] = target[row][col];
+            }
+        }
+    }
+    return true;
+}
+
+void serviceLcd() {
+    char target[LCD_ROWS][LCD_COLS];
+    uint32_t seq;
+
+    // Frames flushed while one is drawn are skipped, only the latest is finished
+    do {
+        portENTER_CRITICAL(&frameMux);
+        memcpy(target, pending, sizeof(target));
+        seq = frameSeq;
+        portEXIT_CRITICAL(&frameMux);
+    } while (!drawFrame(target, seq));
+}
+
+// ============================================================================
+//   Home Screen
 //   Displays current date, time, program state, and temperature on the LCD.
+//   Redrawn in full from the software clock; the flush only sends the
+//   cells that changed (usually the seconds).
 // ============================================================================
-void initHome() {
-    lcd.clear();
-    lcd.home();
+static void drawHome() {
+    ClockTime now = getClock();
+
+    clearFrame();
 
     // -------------------------
     // Display Date: Day, DD/MM/YYYY
     // -------------------------
-    lcd.setCursor(1, 0);
-    lcd.print(DaysOfWeek[dayOfWeekNow - 1]); // Day of week
-    lcd.print(',');
-    lcd.print(dayNow / 10);
-    lcd.print(dayNow % 10);
-    lcd.print('/');
-    lcd.print(monthNow / 10);
-    lcd.print(monthNow % 10);
-    lcd.print('/');
-    lcd.print((yearNow / 1000) % 10);
-    lcd.print((yearNow / 100) % 10);
-    lcd.print((yearNow / 10) % 10);
-    lcd.print(yearNow % 10);
+    frameCursor(1, 0);
+    framePrint(DaysOfWeek[now.dayOfWeek - 1]); // Day of week
+    frameWrite(',');
+    framePrint(now.day, 2);
+    frameWrite('/');
+    framePrint(now.month, 2);
+    frameWrite('/');
+    framePrint(now.year, 4);
 
     // -------------------------
     // Display Time: HH:MM:SS
     // -------------------------
-    lcd.setCursor(0, 1);
-    lcd.print(hourNow / 10);
-    lcd.print(hourNow % 10);
-    lcd.print(':');
-    lcd.print(minuteNow / 10);
-    lcd.print(minuteNow % 10);
-    lcd.print(':');
-    lcd.print(secondNow / 10);
-    lcd.print(secondNow % 10);
+    frameCursor(0, 1);
+    framePrint(now.hour, 2);
+    frameWrite(':');
+    framePrint(now.minute, 2);
+    frameWrite(':');
+    framePrint(now.second, 2);
 
     // -------------------------
     // Display Program AlarmState and Temperature
     // -------------------------
-    lcd.print(' ');
-    lcd.write(eeprom.state ? ON_CHAR : OFF_CHAR); // ON_CHAR/OFF_CHAR symbol
-    lcd.print(' ');
-    lcd.write(THERMOMETER_CHAR);           // Thermometer symbol
-    lcd.print((byte)temperatureNow / 10);
-    lcd.print((byte)temperatureNow % 10);
-    lcd.write(DEGRE_CHAR);                 // Degree symbol
-    lcd.print('C');
+    frameWrite(' ');
+    frameWrite(scheduledState() ? ON_CHAR : OFF_CHAR); // ON_CHAR/OFF_CHAR symbol
+    frameWrite(' ');
+    frameWrite(THERMOMETER_CHAR);           // Thermometer symbol
+    framePrint(now.temperature, 2);
+    frameWrite((char)DEGRE_CHAR);           // Degree symbol
+    frameWrite('C');
+
+    flushFrame();
+}
+
+void initHome() {
+    drawHome();
 }
 
-// ============================================================================
-//   Refresh Home Screen
-//   Updates only the parts of the display that have changed since last refresh.
-// ============================================================================
 void refreshHome() {
-    if (dayOfWeekNow != prevDayOfWeek) {
-        lcd.setCursor(1, 0);
-        lcd.print(DaysOfWeek[dayOfWeekNow - 1]);
-    }
-    if (dayNow != prevDay) {
-        lcd.setCursor(5, 0);
-        lcd.print(dayNow / 10);
-        lcd.print(dayNow % 10);
-    }
-    if (monthNow != prevMonth) {
-        lcd.setCursor(8, 0);
-        lcd.print(monthNow / 10);
-        lcd.print(monthNow % 10);
-    }
-    if (yearNow != prevYear) {
-        lcd.setCursor(11, 0);
-        lcd.print((yearNow / 1000) % 10);
-        lcd.print((yearNow / 100) % 10);
-        lcd.print((yearNow / 10) % 10);
-        lcd.print(yearNow % 10);
-    }
-    if (hourNow != prevHour) {
-        lcd.setCursor(0, 1);
-        lcd.print(hourNow / 10);
-        lcd.print(hourNow % 10);
-    }
-    if (minuteNow != prevMinute) {
-        lcd.setCursor(3, 1);
-        lcd.print(minuteNow / 10);
-        lcd.print(minuteNow % 10);
-    }
-    if (secondNow != prevSecond) {
-        lcd.setCursor(6, 1);
-        lcd.print(secondNow / 10);
-        lcd.print(secondNow % 10);
-    }
-    if (temperatureNow != prevTemperature) {
-        lcd.setCursor(12, 1);
-        lcd.print(temperatureNow / 10);
-        lcd.print(temperatureNow % 10);
-    }
+    drawHome();
 }
 
 // ============================================================================
@@ -105,67 +161,135 @@ void refreshHome() {
 //   Shows alarm details including time, duration/state, active days, and navigation.
 // ============================================================================
 void displayAlarm() {
-    lcd.clear();
-    lcd.home();
+    const Schedule *table = acquireSchedule();
+    uint16_t count = table->alarmCount;
+    Alarm alarm = alarmIndex < count ? table->alarms[alarmIndex] : 0;
+    byte programType = table->programType;
+    releaseSchedule(table);
+
+    clearFrame();
 
     // -------------------------
-    // Display Alarm Number
+    // Display Alarm Number (up to 4 digits)
     // -------------------------
-    lcd.print('n');
-    lcd.write(DEGRE_CHAR); // Degree symbol used as a separator
-    lcd.print((alarmIndex + 1) / 10);
-    lcd.print((alarmIndex + 1) % 10);
-    lcd.print("  ");
+    frameWrite('n');
+    frameWrite((char)DEGRE_CHAR); // Degree symbol used as a separator
+    framePrint(alarmIndex + 1, 4);
+    frameWrite(' ');
 
     // -------------------------
     // Display Alarm Time HH:MM
     // -------------------------
-    lcd.print(eeprom.alarms[alarmIndex].hour / 10);
-    lcd.print(eeprom.alarms[alarmIndex].hour % 10);
-    lcd.print(':');
-    lcd.print(eeprom.alarms[alarmIndex].minute / 10);
-    lcd.print(eeprom.alarms[alarmIndex].minute % 10);
-    lcd.print("  ");
+    framePrint(alarmHour(alarm), 2);
+    frameWrite(':');
+    framePrint(alarmMinute(alarm), 2);
+    frameWrite(' ');
 
     // -------------------------
     // Display Duration or AlarmState
     // -------------------------
-    if (eeprom.programType == 0) { // Numeric duration mode
-        lcd.print(eeprom.alarms[alarmIndex].duration / 10);
-        lcd.print(eeprom.alarms[alarmIndex].duration % 10);
-        lcd.print('s');
+    if (programType == 0) { // Numeric duration mode
+        framePrint(alarmDuration(alarm), 2);
+        frameWrite('s');
     } else { // ON_CHAR/OFF_CHAR mode
-        lcd.print(AlarmState[bitRead(eeprom.alarms[alarmIndex].duration, 0)]);
+        framePrint(AlarmState[bitRead(alarmDuration(alarm), 0)]);
     }
 
     // -------------------------
     // Display Active Days
     // -------------------------
-    lcd.setCursor(0, 1);
+    frameCursor(0, 1);
     for (int i = 6; i >= 1; i--) {
-        lcd.print(bitRead(eeprom.alarms[alarmIndex].days, i) ? 
+        frameWrite(bitRead(alarmDays(alarm), i) ?
         DaysOfWeek[7 - i][0] : '_');
     }
-    lcd.print(bitRead(eeprom.alarms[alarmIndex].days, 7) ? 
+    frameWrite(bitRead(alarmDays(alarm), 7) ?
         DaysOfWeek[0][0] : '_');
 
     // Display alarm ON_CHAR/OFF_CHAR indicator
-    lcd.print("  ");
-    lcd.write(bitRead(eeprom.alarms[alarmIndex].days, 0) ? ON_CHAR : OFF_CHAR);
+    framePrint("  ");
+    frameWrite(alarmActive(alarm) ? ON_CHAR : OFF_CHAR);
 
     // -------------------------
     // Display Navigation Arrows
     // -------------------------
     if (alarmIndex == 0) {
-        lcd.setCursor(15, 1);
-        lcd.write(NEXT_CHAR);
-    } else if (alarmIndex == eeprom.alarmCount - 1) {
-        lcd.setCursor(13, 1);
-        lcd.write(PREV_CHAR);
+        frameCursor(15, 1);
+        frameWrite(NEXT_CHAR);
+    } else if (alarmIndex == count - 1) {
+        frameCursor(13, 1);
+        frameWrite(PREV_CHAR);
     } else {
-        lcd.setCursor(13, 1);
-        lcd.write(PREV_CHAR);
-        lcd.setCursor(15, 1);
-        lcd.write(NEXT_CHAR);
+        frameCursor(13, 1);
+        frameWrite(PREV_CHAR);
+        frameCursor(15, 1);
+        frameWrite(NEXT_CHAR);
+    }
+
+    flushFrame();
+}
+
+// ============================================================================
+//   Restore Screen
+//   Redraws the screen of the current menu, e.g. after a message.
+// ============================================================================
+void restoreScreen() {
+    if (currentMenu == HOME) initHome(); else displayAlarm();
+}
+
+// ============================================================================
+//   Timed Messages
+// ============================================================================
+void showMessage(const char *top, const char *bottom) {
+    clearFrame();
+    framePrint(top);
+    if (bottom != NULL) {
+        frameCursor(0, 1);
+        framePrint(bottom);
     }
+    flushFrame();
+    messageShown = true;
+    messageTime = millis();
+}
+
+bool isMessageShown() {
+    return messageShown;
+}
+
+void serviceMessage() {
+    if (messageShown && millis() - messageTime >= MSG_DELAY) {
+        messageShown = false;
+        restoreScreen();
+    }
+}
+
+uint32_t messageTimeLeft() {
+    if (!messageShown) return NO_DEADLINE;
+    unsigned long shown = millis() - messageTime;
+    return shown >= MSG_DELAY ? 0 : MSG_DELAY - shown;
+}
+
+// ============================================================================
+//   Home Clock Timer
+//   The UI task redraws the home screen at each second of the software clock.
+// ============================================================================
+uint32_t homeTimeLeft() {
+    if (currentMenu != HOME || messageShown) return NO_DEADLINE;
+    uint32_t phase = ticks - getClock().tick;
+    return phase >= 1000 ? 0 : 1000 - phase;
+}
+
+// ============================================================================
+//   7-Segment Display
+//   The divide and modulo are done here once per change instead of at 1 kHz.
+//   Digits are active low: the digit being shown is cleared, the other set.
+// ============================================================================
+void setDuration(byte value) {
+    const uint32_t digits = (1 << DIGIT1) | (1 << DIGIT2);
+
+    duration = value;
+    segmentSet[true] = digits | bcd[value / 10];
+    segmentClear[true] = (ABCD & ~bcd[value / 10]) | (1 << DIGIT1);
+    segmentSet[false] = digits | bcd[value % 10];
+    segmentClear[false] = (ABCD & ~bcd[value % 10]) | (1 << DIGIT2);
 }
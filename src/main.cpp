@@ -5,7 +5,9 @@
 #include "database.h"
 #include "display.h"
 #include "global_vars.h"
+#include "schedule.h"
 #include "server.h"
+#include "tasks.h"
 #include "utils.h"
 #include <Arduino.h>
 #include <LiquidCrystal.h>
@@ -25,29 +27,27 @@ byte off[] = {B00000, B00000, B10001, B01010, B00100, B01010, B10001, B00000};
 //   Global Variables
 // ============================================================================
 hw_timer_t *sevenSegmentTimer = NULL;
-portMUX_TYPE timerMux = portMUX_INITIALIZER_UNLOCKED;
-volatile bool flag = true;
+volatile uint32_t ticks = 0;         // Milliseconds counted by the ISR (single writer)
+uint32_t missedTicks = 0;            // Seconds the scheduler was late by, caught up since boot
 
 MenuLcd currentMenu = HOME;
-byte lockTime = 0;
+unsigned long lockTime = 0;
 boolean firstDigit;
+volatile uint32_t segmentSet[2];     // Per-digit W1TS masks, see setDuration()
+volatile uint32_t segmentClear[2];   // Per-digit W1TC masks, see setDuration()
 
 EEPROMData eeprom;
 byte tempByte;
 int alarmIndex;
-byte hourNow, minuteNow, secondNow, dayNow, monthNow, dayOfWeekNow;
-byte prevHour, prevMinute, prevSecond, prevDay, prevMonth, prevDayOfWeek;
-unsigned int yearNow, prevYear;
-byte temperatureNow, prevTemperature;
 DS3231 myRTC;
 bool century;
 bool h12Flag; // 12-hour format flag
 bool pmFlag;  // AM/PM flag
 byte duration;
-int count;
 
 Preferences preferences;
 BluetoothSerial SerialBT;
+BluetoothTransport bluetoothTransport(SerialBT);
 LiquidCrystal lcd(RS, EN, D4, D5, D6, D7);
 
 // ============================================================================
@@ -57,12 +57,7 @@ LiquidCrystal lcd(RS, EN, D4, D5, D6, D7);
 void setup() {
     preferences.begin(DB_NAME, false);
 
-    // Initialize EEPROM with default values
-    preferences.putInt(PROGRAM_TYPE_KEY, 0);
-    preferences.putInt(NBR_ALARMS_KEY, 0);
-    preferences.putInt(DESCRIPTION_LEN_KEY, 0);
-    preferences.putInt(AUTHOR_LEN_KEY, 0);
-    preferences.putInt(STATE_KEY, 0);
+    // Initialize EEPROM with default values (eeprom starts zeroed)
 
     const byte defaultPassword[32] = { // sha256 of "0000"
         0x9a, 0xf1, 0x5b, 0x33, 0x6e, 0x6a, 0x96, 0x19,
@@ -70,7 +65,8 @@ void setup() {
         0x37, 0x65, 0x69, 0xfc, 0xf9, 0xd7, 0xe7, 0x73,
         0xec, 0xce, 0xde, 0x65, 0x60, 0x65, 0x29, 0xa0
     };
-    preferences.putBytes(PASSWORD_KEY, defaultPassword, PASSWORD_LEN);
+    memcpy(eeprom.password, defaultPassword, PASSWORD_LEN);
+    storeRecord();
     preferences.end();
 }
 
@@ -85,6 +81,7 @@ void setup() {
     pinMode(LOCK_BTN, INPUT_PULLUP);
     pinMode(DOWN_BTN, INPUT_PULLUP);
     pinMode(UP_BTN, INPUT_PULLUP);
+    initButtons();
 
     // Configure outputs
     pinMode(BUZZER, OUTPUT);
@@ -98,6 +95,7 @@ void setup() {
     pinMode(B, OUTPUT);
     pinMode(C, OUTPUT);
     pinMode(D, OUTPUT);
+    setDuration(0);
 
     // Initialize LCD
     lcd.begin(16, 2);
@@ -110,18 +108,14 @@ void setup() {
 
     lcd.home();
     lcd.print("    OpenTimer   ");
+    invalidateFrame();
 
     // Initialize I2C
     Wire.begin();
 
-    // Load stored eeprom from Preferences (EEPROM)
-    preferences.begin(DB_NAME, true);
-    getProgramType();
-    getAlarms();
-    getDescription();
-    getAuthor();
-    getPassword();
-    getState();
+    // Load stored eeprom from Preferences (EEPROM), read-write for the migration
+    preferences.begin(DB_NAME, false);
+    loadRecord();
     preferences.end();
 
     serialFlush();
@@ -141,53 +135,36 @@ void setup() {
         initRelay();
     }
 
-    // Start Bluetooth
+    // Start Bluetooth. UART0 is not a transport: GPIO1 and GPIO3 drive DIGIT2 and LED
     SerialBT.begin("OpenTimer Bluetooth");
+    registerTransport(bluetoothTransport);
+
+    // Hand over to the alarm, UI and protocol tasks
+    startTasks();
 }
 
 // ============================================================================
 //   7-Segment Display Timer ISR
+//   Two atomic writes per call: W1TS blanks both digits and raises the
+//   segments of the digit, W1TC lowers the other segments and enables it.
+//   No read-modify-write, so RELAY and LED writes from the tasks are safe.
 // ============================================================================
 void IRAM_ATTR onSevenSegmentDisplayToggle() {
     firstDigit = !firstDigit;
 
-    // Enable both digits
-    REG_WRITE(GPIO_OUT_REG, REG_READ(GPIO_OUT_REG) | 1 << DIGIT1 | 1 << DIGIT2);
-
-    // Disable segments ABCD temporarily
-    REG_WRITE(GPIO_OUT_REG, REG_READ(GPIO_OUT_REG) & ~(ABCD));
-
-    if (firstDigit) {
-        REG_WRITE(GPIO_OUT_REG, REG_READ(GPIO_OUT_REG) | bcd[duration / 10]);
-        REG_WRITE(GPIO_OUT_REG, REG_READ(GPIO_OUT_REG) & ~(1 << DIGIT1));
-    } else {
-        REG_WRITE(GPIO_OUT_REG, REG_READ(GPIO_OUT_REG) | bcd[duration % 10]);
-        REG_WRITE(GPIO_OUT_REG, REG_READ(GPIO_OUT_REG) & ~(1 << DIGIT2));
-    }
+    REG_WRITE(GPIO_OUT_W1TS_REG, segmentSet[firstDigit]);
+    REG_WRITE(GPIO_OUT_W1TC_REG, segmentClear[firstDigit]);
 
-    count = (count + 1) % 1000;
-    if (count == 0) {
-        portENTER_CRITICAL_ISR(&timerMux);
-        flag = true;
-        portEXIT_CRITICAL_ISR(&timerMux);
-    }
+    // Only writer: an aligned 32-bit store, read by the tasks without locking
+    ticks = ticks + 1;
 }
 
 // ============================================================================
 //   Main Loop
+//   Work is done by the alarm, UI and protocol tasks (see tasks.cpp).
 // ============================================================================
 void loop() {
-    readBtns();
-
-    if (flag) {
-        portENTER_CRITICAL(&timerMux);
-        flag = false;
-        portEXIT_CRITICAL(&timerMux);
-        everySecond(); // Called every 1 second
-    }
-
-    handleMenu();   // Handle LCD menu navigation
-    execRequest();  // Handle Bluetooth requests
+    vTaskDelete(NULL);
 }
 
 #endif
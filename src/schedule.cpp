@@ -0,0 +1,189 @@
+#include "schedule.h"
+#include "global_vars.h"
+#include <atomic>
+
+// ============================================================================
+//   Global Variables
+// ============================================================================
+Schedule schedules[2];                  // Published and inactive buffers
+std::atomic<byte> publishedSchedule(0); // Index of the published buffer
+std::atomic<byte> scheduleReaders[2];   // Readers holding each buffer
+
+uint16_t alarmOrder[MAX_ALARMS];        // Alarm indexes sorted by time of day (compile scratch)
+
+// Lookup cursor of the alarm task, valid for one version of the schedule
+uint16_t eventCursor;                   // Index in events[] of the next due event
+uint16_t eventCursorMinute;             // Minute of the week of events[eventCursor]
+uint16_t eventCursorVersion;            // Version the cursor was placed on
+bool eventCursorValid = false;          // Cleared until the first seek
+
+// ============================================================================
+//   Helpers
+// ============================================================================
+static inline bool isMinuteSet(const Schedule &table, uint16_t minute) {
+    return (table.bitmap[minute >> 5] >> (minute & 31)) & 1;
+}
+
+// Sort by time of day, then by table index so the first alarm of the table wins
+static int compareAlarms(const void *a, const void *b) {
+    uint16_t ia = *(const uint16_t *)a;
+    uint16_t ib = *(const uint16_t *)b;
+    int diff = alarmMinuteOfDay(eeprom.alarms[ia]) - alarmMinuteOfDay(eeprom.alarms[ib]);
+    return diff != 0 ? diff : ia - ib;
+}
+
+// First set minute at or after `minute`, MINUTES_PER_WEEK if none (no wrap)
+static uint16_t findSetMinute(const Schedule &table, uint16_t minute) {
+    if (minute >= MINUTES_PER_WEEK) return MINUTES_PER_WEEK;
+
+    uint16_t word = minute >> 5;
+    uint32_t bits = table.bitmap[word] & (0xFFFFFFFFUL << (minute & 31));
+
+    while (bits == 0) {
+        if (++word >= WEEK_WORDS) return MINUTES_PER_WEEK;
+        bits = table.bitmap[word];
+    }
+    return (word << 5) + __builtin_ctz(bits);
+}
+
+// Place the cursor on the first event at or after `minute` (wraps to the next week)
+static void seekSchedule(const Schedule &table, uint16_t minute) {
+    if (minute >= MINUTES_PER_WEEK) minute = 0; // Clock not read yet
+
+    uint16_t rank = 0;
+    for (uint16_t w = 0; w < (minute >> 5); w++) {
+        rank += __builtin_popcount(table.bitmap[w]);
+    }
+    if (minute & 31) {
+        rank += __builtin_popcount(table.bitmap[minute >> 5] & ((1UL << (minute & 31)) - 1));
+    }
+
+    eventCursorVersion = table.version;
+    eventCursorValid = true;
+    eventCursorMinute = findSetMinute(table, minute);
+    eventCursor = rank;
+    if (eventCursorMinute == MINUTES_PER_WEEK) {
+        eventCursor = 0;
+        eventCursorMinute = findSetMinute(table, 0);
+    }
+}
+
+// ============================================================================
+//   Compile Alarm Table into the Weekly Timeline
+//   Built in the inactive buffer, then published by one atomic store.
+// ============================================================================
+void compileSchedule() {
+    byte current = publishedSchedule.load();
+    byte next = current ^ 1;
+
+    // A reader that acquired this buffer before the last publish may still use it
+    while (scheduleReaders[next].load() != 0) vTaskDelay(1);
+
+    Schedule &table = schedules[next];
+    memcpy(table.alarms, eeprom.alarms, eeprom.alarmCount * sizeof(Alarm));
+    table.alarmCount = eeprom.alarmCount;
+    table.state = eeprom.state;
+    table.programType = eeprom.programType;
+    memset(table.bitmap, 0, sizeof(table.bitmap));
+    table.eventCount = 0;
+    table.version = schedules[current].version + 1;
+
+    for (uint16_t i = 0; i < eeprom.alarmCount; i++) alarmOrder[i] = i;
+    qsort(alarmOrder, eeprom.alarmCount, sizeof(uint16_t), compareAlarms);
+
+    // Days in week order and alarms in time order: events come out sorted
+    for (byte day = 0; day < 7; day++) {
+        for (uint16_t k = 0; k < eeprom.alarmCount; k++) {
+            uint16_t idx = alarmOrder[k];
+            byte days = alarmDays(eeprom.alarms[idx]);
+
+            if (!bitRead(days, 0) || !bitRead(days, 7 - day)) continue;
+
+            uint16_t minute = day * MINUTES_PER_DAY + alarmMinuteOfDay(eeprom.alarms[idx]);
+            if (isMinuteSet(table, minute)) continue; // An earlier alarm already owns this minute
+
+            table.bitmap[minute >> 5] |= 1UL << (minute & 31);
+            table.events[table.eventCount++] = idx;
+        }
+    }
+
+    publishedSchedule.store(next);
+}
+
+// ============================================================================
+//   Lock-free Access to the Published Schedule
+//   The reader announces itself on the buffer, then checks the buffer is
+//   still the published one: if a publish slipped in between, the writer may
+//   already be rebuilding it, so the reader moves to the new buffer.
+// ============================================================================
+const Schedule *acquireSchedule() {
+    while (true) {
+        byte index = publishedSchedule.load();
+        scheduleReaders[index]++;
+        if (publishedSchedule.load() == index) return &schedules[index];
+        scheduleReaders[index]--;
+    }
+}
+
+void releaseSchedule(const Schedule *table) {
+    scheduleReaders[table - schedules]--;
+}
+
+uint16_t scheduleVersion() {
+    return schedules[publishedSchedule.load()].version;
+}
+
+uint16_t scheduledAlarmCount() {
+    return schedules[publishedSchedule.load()].alarmCount;
+}
+
+byte scheduledState() {
+    return schedules[publishedSchedule.load()].state;
+}
+
+byte scheduledProgramType() {
+    return schedules[publishedSchedule.load()].programType;
+}
+
+// ============================================================================
+//   Minute of the Week
+// ============================================================================
+uint16_t minuteOfWeek(byte dayOfWeek, byte hour, byte minute) {
+    return (dayOfWeek - 1) * MINUTES_PER_DAY + hour * 60 + minute;
+}
+
+// ============================================================================
+//   Lookup Alarm Starting at a Given Minute
+//   The bitmap answers in constant time; the cursor normally already points at
+//   the matching event and only needs a seek after a clock change or a new
+//   version of the schedule.
+// ============================================================================
+int scheduledAlarm(const Schedule &table, uint16_t minute) {
+    if (minute >= MINUTES_PER_WEEK || !isMinuteSet(table, minute)) return NO_ALARM;
+
+    if (!eventCursorValid || eventCursorVersion != table.version || eventCursorMinute != minute) {
+        seekSchedule(table, minute);
+    }
+
+    int idx = table.events[eventCursor];
+
+    // Advance to the following event, wrapping to the start of the week
+    eventCursor++;
+    eventCursorMinute = findSetMinute(table, minute + 1);
+    if (eventCursorMinute == MINUTES_PER_WEEK) {
+        eventCursor = 0;
+        eventCursorMinute = findSetMinute(table, 0);
+    }
+    return idx;
+}
+
+// ============================================================================
+//   Next Event
+// ============================================================================
+uint16_t nextEventMinute(const Schedule &table, uint16_t minute) {
+    if (table.eventCount == 0) return MINUTES_PER_WEEK;
+    if (eventCursorValid && eventCursorVersion == table.version && minute == eventCursorMinute) return minute;
+
+    uint16_t next = findSetMinute(table, minute);
+    return next != MINUTES_PER_WEEK ? next : findSetMinute(table, 0);
+}
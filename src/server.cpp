@@ -3,364 +3,1199 @@
 #include "datatypes.h"
 #include "display.h"
 #include "global_vars.h"
+#include "schedule.h"
 #include "utils.h"
 #include <Arduino.h>
+#include <mbedtls/md.h>
 
 // ============================================================================
 //   Constants
 // ============================================================================
 #define TX_BUFFER_SIZE 200
+#define TX_HEADER_SIZE 3     // Room for the response header: length (1 byte in v1, 2 after) and v3 sequence number
+#define REQUEST_TIMEOUT 2000 // Time allowed to receive a full request (ms)
 
-// Macros for reading bytes from SerialBT
-#define SERIAL_READ_BYTE(x) \
-  x = SerialBT.read(); \
-  size--;
-
-#define SERIAL_READ_BYTE_S(x) \
-  if (size == 0) goto end; \
-  if (SerialBT.available() == 0) goto end; \
-  SERIAL_READ_BYTE(x)
-
-#define SERIAL_READ_SIZE(x) \
-  SERIAL_READ_BYTE_S(x) \
-  if (size < x) \
-    goto bad;
-
-#define SERIAL_READ() \
-  SerialBT.read(); \
-  size--;
-
-// Macros for writing bytes to SerialBT with overflow check
-#define SERIAL_WRITE_BYTE(x) \
-  if (idx >= TX_BUFFER_SIZE) { \
-    SerialBT.write(0x01); \
-    SerialBT.write(BUFFER_OVERFLOW); \
-    SerialBT.flush(); \
-    goto end; \
-  } \
-  txBuffer[idx] = x; \
-  idx++;
-
-// Flush remaining SerialBT eeprom
+// Receive ring, must be a power of 2 and hold one full request
+#define RX_RING_SIZE 8192
+#define RX_RING_MASK (RX_RING_SIZE - 1)
+#define MAX_REQUEST_SIZE (RX_RING_SIZE - CRC_SIZE)
+
+// v2: set in the length of every response frame but the last one
+#define CHUNK_MORE 0x8000
+
+// v3: CRC-16 appended to every frame
+#define CRC_SIZE 2
+
+// Sessions
+#define CHALLENGE_LEN 16     // Random bytes the client signs to log in
+#define TOKEN_LEN 4          // Session token sent by POST_SESSION
+#define NO_SESSION 0         // Token value never issued
+
+// Write the DS3231 while holding the RTC lock (shared with the alarm task)
+#define RTC_SET(x) \
+  lockRtc(); \
+  x; \
+  unlockRtc(); \
+  resyncClock();
+
+// Drop the unread bytes of the current request
 #define FLUSH_REQUEST() \
-  while (size != 0) { \
-    SerialBT.read(); \
-    size--; \
-  }
+  rxTail += size; \
+  size = 0;
 
 // ============================================================================
 //   Global Variables
 // ============================================================================
 unsigned char txBuffer[TX_BUFFER_SIZE]; // Buffer for outgoing eeprom
-byte size = 0;
-TaskHandle_t taskHandle = NULL; // Handle to cancel timeout task
+bool responseOpen = false;     // v2: a chunk with CHUNK_MORE was sent, the response is not finished
+unsigned long requestDeadline; // millis() by which the pending request must be complete
+
+Transport *transports[MAX_TRANSPORTS]; // Registered links, in priority order
+byte transportCount = 0;
+Transport *transport = NULL;   // Link being served, NULL when no client is attached
+
+byte rxRing[RX_RING_SIZE];     // Bytes received from the transport, not parsed yet
+uint16_t rxHead = 0;           // Free-running write position
+uint16_t rxTail = 0;           // Free-running read position
+
+// Parser state, kept across calls of execRequest()
+enum ParseState {
+    WAIT_SIZE,    // Next bytes are the size of a request
+    WAIT_PAYLOAD  // Waiting for `size` bytes of payload
+};
+ParseState parseState = WAIT_SIZE;
+uint16_t size = 0;             // Payload bytes of the current request not read yet
+byte requestSeq = 0;           // v3: sequence number of the current request, echoed in its responses
+uint16_t requestCrc;           // v3: CRC of the current request header
+
+byte protocolVersion = PROTOCOL_V1; // Framing of the current connection
+byte nextProtocolVersion = PROTOCOL_V1; // Framing once the current request is answered
+
+byte challenge[CHALLENGE_LEN]; // Pending login challenge
+bool challengeIssued = false;  // challenge is valid for one POST_LOGIN
+uint32_t sessionToken = NO_SESSION; // Token of the open session
+bool sessionClosing = false;   // End the session once the current request is answered
+
+Alarm uploadAlarms[MAX_ALARMS]; // SET_ALARMS_PAGE: pages received so far, not published
+uint16_t uploadCount;          // Alarm count announced by the pages of the upload
+byte uploadNext = 0;           // Next page expected, 0 when no upload is staged
+
+byte subscriptions = 0;        // SUBSCRIBE mask of the connected client
+ClockTime eventClock;          // Last clock pushed
+byte eventState;               // Last state pushed
 
 bool ledOn = true;
 
+void toggleLed() {
+    digitalWrite(LED, ledOn ? HIGH : LOW);
+    ledOn = !ledOn;
+}
+
 // ============================================================================
-//   Timeout Task for Bluetooth Request
+//   Receive Ring
+//   The transport is drained in bulk reads; the handlers then read the payload in
+//   place, without copying it out of the ring.
 // ============================================================================
-void enableTimeout() {
-    if (taskHandle != NULL) return; // Already running
-    xTaskCreatePinnedToCore(
-        taskFunction,   // Function to run
-        "TimeoutTask",  // Task name
-        2048,           // Stack size (2 KB)
-        NULL,           // Parameters
-        1,              // Priority
-        &taskHandle,    // Task handle
-        1               // Run on core 1
-    );
+static uint16_t ringCount() {
+    return rxHead - rxTail;
 }
 
-void disableTimeout() {
-    if (taskHandle != NULL) {
-        vTaskDelete(taskHandle);
-        taskHandle = NULL;
+static void fillRing() {
+    int available;
+    while ((available = transport->available()) > 0 && ringCount() < RX_RING_SIZE) {
+        uint16_t offset = rxHead & RX_RING_MASK;
+        uint16_t room = min<uint16_t>(RX_RING_SIZE - ringCount(), RX_RING_SIZE - offset);
+        size_t n = transport->read(rxRing + offset, min<uint16_t>(room, available));
+        if (n == 0) break;
+        rxHead += n;
     }
 }
 
-void toggleLed() {
-    digitalWrite(LED, ledOn ? HIGH : LOW);
-    ledOn = !ledOn;
+static byte requestRead() {
+    size--;
+    return rxRing[rxTail++ & RX_RING_MASK];
+}
+
+// CRC of `length` ring bytes starting at the read position
+static uint16_t ringCrc(uint16_t length, uint16_t crc) {
+    uint16_t offset = rxTail & RX_RING_MASK;
+    uint16_t part = min<uint16_t>(length, RX_RING_SIZE - offset);
+
+    crc = crc16(rxRing + offset, part, crc);
+    return crc16(rxRing, length - part, crc); // Wrapped part, if any
+}
+
+static uint16_t ringPeek16(uint16_t offset) {
+    return rxRing[(rxTail + offset) & RX_RING_MASK] | rxRing[(rxTail + offset + 1) & RX_RING_MASK] << 8;
+}
+
+// ============================================================================
+//   Response Frames
+//   → v1: [length][data], length on 1 byte.
+//   → v2: [length low][length high][data]. A large response is streamed in
+//     several frames, all but the last with CHUNK_MORE set; the transport
+//     write blocks while the link is full, which paces the stream.
+//   → v3: [length low][length high][seq][data][crc low][crc high], seq is the
+//     sequence number of the request being answered.
+// ============================================================================
+
+// Write a frame whose header ends right before its data, adding the CRC in v3
+static void writeFrame(const byte *frame, uint16_t length) {
+    transport->write(frame, length);
+    if (protocolVersion == PROTOCOL_V3) {
+        uint16_t crc = crc16(frame, length);
+        byte trailer[CRC_SIZE] = {(byte)(crc & 0xFF), (byte)(crc >> 8)};
+        transport->write(trailer, CRC_SIZE);
+    }
 }
 
-// Task executed 2 seconds after request start
-void taskFunction(void *parameter) {
-    vTaskDelay(2000 / portTICK_PERIOD_MS); // Wait 2 seconds
+// Send txBuffer[TX_HEADER_SIZE..idx) as one frame, returns the new write index
+static byte sendResponse(byte idx, bool more) {
+    uint16_t length = idx - TX_HEADER_SIZE;
+    byte *frame;
+
+    if (protocolVersion == PROTOCOL_V1) {
+        frame = txBuffer + 2;
+        frame[0] = length;
+    } else {
+        if (more) length |= CHUNK_MORE;
+        frame = protocolVersion == PROTOCOL_V2 ? txBuffer + 1 : txBuffer;
+        frame[0] = length & 0xFF;
+        frame[1] = length >> 8;
+        if (protocolVersion == PROTOCOL_V3) frame[2] = requestSeq;
+    }
+    writeFrame(frame, txBuffer + idx - frame);
+    if (!more) transport->flush();
+
+    responseOpen = more;
+    return TX_HEADER_SIZE;
+}
+
+// Send a one-byte status frame (BAD_REQUEST, TIMEOUT, ERROR...), ends any open response
+static void sendCode(byte code) {
+    byte frame[4];
+    byte n = 0;
+
+    frame[n++] = 0x01;
+    if (protocolVersion != PROTOCOL_V1) frame[n++] = 0x00;
+    if (protocolVersion == PROTOCOL_V3) frame[n++] = requestSeq;
+    frame[n++] = code;
 
-    SerialBT.write(0x01);
-    SerialBT.write(TIMEOUT);
-    SerialBT.flush();
+    writeFrame(frame, n);
+    transport->flush();
+    responseOpen = false;
+}
+
+// ============================================================================
+//   Sessions
+//   → GET_CHALLENGE returns random bytes, the client answers POST_LOGIN with
+//     HMAC-SHA256(key = password hash, challenge); the hash never travels.
+//   → The session token then replaces the password in every request until
+//     the client disconnects. NVS stays open for the whole session.
+// ============================================================================
+static void resetSubscriptions(byte mask) {
+    subscriptions = mask;
+    eventClock.second = eventClock.minute = 0xFF; // Push the current values first
+    eventState = 0xFF;
+}
+
+// Forget the pages of an unfinished SET_ALARMS_PAGE upload
+static void dropUpload() {
+    uploadNext = 0;
+}
+
+static void endSession() {
+    if (sessionToken != NO_SESSION) preferences.end();
+    sessionToken = NO_SESSION;
+    challengeIssued = false;
+    sessionClosing = false;
+}
+
+static bool checkLogin(const byte *answer) {
+    byte expected[32];
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), eeprom.password, PASSWORD_LEN,
+                    challenge, CHALLENGE_LEN, expected);
+
+    byte diff = 0;
+    for (byte i = 0; i < sizeof(expected); i++) diff |= expected[i] ^ answer[i]; // Constant time
+    return diff == 0;
+}
+
+// ============================================================================
+//   Request Timeout
+//   A single deadline, armed when the size byte of a request is parsed and
+//   checked by the protocol task on each pass. Nothing is allocated.
+// ============================================================================
+void checkTimeout() {
+    if (parseState != WAIT_PAYLOAD || (long)(millis() - requestDeadline) < 0) return;
+
+    sendCode(TIMEOUT);
     serialFlush();
     toggleLed();
-    taskHandle = NULL;
-    vTaskDelete(NULL); // Delete itself
 }
 
 // ============================================================================
-//   Helper: Flush SerialBT input
+//   Helper: Flush transport input
 // ============================================================================
 void serialFlush() {
-    while (SerialBT.available()) {
-        SerialBT.read();
+    byte scratch[32];
+    while (transport != NULL && transport->available() > 0) {
+        if (transport->read(scratch, sizeof(scratch)) == 0) break;
     }
+    rxTail = rxHead;
     size = 0;
+    parseState = WAIT_SIZE;
 }
 
+static void handleRequest();
+
 // ============================================================================
-//   Main Bluetooth Request Handler
+//   Transports
+//   One link is served at a time: a client on another link waits until the
+//   served one disconnects. Switching links starts from a clean state.
 // ============================================================================
-void execRequest() {
-    if (SerialBT.available() < 1) return;
+void registerTransport(Transport &link) {
+    if (transportCount < MAX_TRANSPORTS) transports[transportCount++] = &link;
+}
+
+// Release the served link, returns true once a connected link is selected
+static bool selectTransport() {
+    if (transport != NULL && transport->connected()) return true;
 
-    if (size == 0) {
-        size = SerialBT.read(); // First byte = total size
-        enableTimeout();
+    if (transport != NULL) {
+        protocolVersion = nextProtocolVersion = PROTOCOL_V1;
+        endSession();
+        dropUpload();
+        subscriptions = 0;
+        serialFlush(); // Drop what is left of the old link
+        transport = NULL;
     }
 
-    if (SerialBT.available() < size) return; // Wait until all eeprom received
-    disableTimeout();
+    for (byte i = 0; i < transportCount; i++) {
+        if (transports[i]->connected()) {
+            transport = transports[i];
+            return true;
+        }
+    }
+    return false;
+}
 
-    bool passwordSent = false;
-    bool isPasswordCorrect = false;
-    bool showSuccessMsg = false;
+// ============================================================================
+//   Main Request Handler
+//   Resumable parser: each call moves what the transport received into the
+//   ring, then executes every request that is complete. A partial request
+//   simply waits in the ring for the next call.
+// ============================================================================
+void execRequest() {
+    if (!selectTransport()) return;
 
-    byte idx = 1; // First byte reserved for length in response
+    checkTimeout();
+    fillRing();
 
     while (true) {
-        SERIAL_READ_BYTE_S(tempByte);
-
-        switch (tempByte) {
-
-            // ------------------ Connection Events ------------------
-            case CONNECTED:
-                lcd.home(); lcd.clear();
-                tone(BUZZER, BUZZER_FREQ, 200);
-                lcd.print("   CONNECTED    ");
-                delay(300);
-                tone(BUZZER, BUZZER_FREQ, 200);
-                delay(MSG_DELAY);
-                if (currentMenu == HOME) initHome(); else displayAlarm();
-                break;
-
-            case DISCONNECTED:
-                lcd.home(); lcd.clear();
-                tone(BUZZER, BUZZER_FREQ, 200);
-                lcd.print("  DISCONNECTED  ");
-                delay(300);
-                tone(BUZZER, BUZZER_FREQ, 200);
-                delay(MSG_DELAY);
-                if (currentMenu == HOME) initHome(); else displayAlarm();
-                break;
-
-            // ------------------ GET Commands ------------------
-            case GET_PROGRAM_TYPE:
-                SERIAL_WRITE_BYTE(SET_PROGRAM_TYPE);
-                SERIAL_WRITE_BYTE(eeprom.programType);
-                break;
-
-            case GET_ALARMS:
-                SERIAL_WRITE_BYTE(SET_ALARMS);
-                SERIAL_WRITE_BYTE(4 * eeprom.alarmCount);
-                for (byte i = 0; i < eeprom.alarmCount; i++) {
-                    SERIAL_WRITE_BYTE(eeprom.alarms[i].hour);
-                    SERIAL_WRITE_BYTE(eeprom.alarms[i].minute);
-                    SERIAL_WRITE_BYTE(eeprom.alarms[i].duration);
-                    SERIAL_WRITE_BYTE(eeprom.alarms[i].days);
-                }
-                break;
-
-            case GET_DESCRIPTION:
-                SERIAL_WRITE_BYTE(SET_DESCRIPTION);
-                SERIAL_WRITE_BYTE(eeprom.descriptionLength);
-                for (byte i = 0; i < eeprom.descriptionLength; i++) {
-                    SERIAL_WRITE_BYTE(eeprom.description[i]);
-                }
-                break;
-
-            case GET_AUTHOR:
-                SERIAL_WRITE_BYTE(SET_AUTHOR);
-                SERIAL_WRITE_BYTE(eeprom.authorLength);
-                for (byte i = 0; i < eeprom.authorLength; i++) {
-                    SERIAL_WRITE_BYTE(eeprom.author[i]);
-                }
-                break;
-
-            case GET_HOUR: SERIAL_WRITE_BYTE(SET_HOUR); SERIAL_WRITE_BYTE(myRTC.getHour(h12Flag, pmFlag)); break;
-            case GET_MINUTE: SERIAL_WRITE_BYTE(SET_MINUTE); SERIAL_WRITE_BYTE(myRTC.getMinute()); break;
-            case GET_SECOND: SERIAL_WRITE_BYTE(SET_SECOND); SERIAL_WRITE_BYTE(myRTC.getSecond()); break;
-            case GET_DAY_OF_WEEK: SERIAL_WRITE_BYTE(SET_DAY_OF_WEEK); SERIAL_WRITE_BYTE(myRTC.getDoW()); break;
-            case GET_DAY: SERIAL_WRITE_BYTE(SET_DAY); SERIAL_WRITE_BYTE(myRTC.getDate()); break;
-            case GET_MONTH: SERIAL_WRITE_BYTE(SET_MONTH); SERIAL_WRITE_BYTE(myRTC.getMonth(century)); break;
-            case GET_YEAR: SERIAL_WRITE_BYTE(SET_YEAR); SERIAL_WRITE_BYTE(myRTC.getYear()); break;
-            case GET_TEMPERATURE: SERIAL_WRITE_BYTE(SET_TEMPERATURE); SERIAL_WRITE_BYTE((byte)roundf(myRTC.getTemperature())); break;
-            case GET_STATE: SERIAL_WRITE_BYTE(SET_STATE); SERIAL_WRITE_BYTE(eeprom.state); break;
-
-            // ------------------ SET Commands ------------------
-            case SET_PROGRAM_TYPE:
-                SERIAL_READ_BYTE_S(tempByte);
-                if (isPasswordCorrect) {
-                    eeprom.programType = tempByte;
-                    if (!storeProgramType) { handleError(); return; }
-                }
-                break;
-
-            case SET_PASSWORD:
-                if (size < PASSWORD_LEN) goto bad;
-                if (isPasswordCorrect) {
-                    for (byte i = 0; i < PASSWORD_LEN; i++) SERIAL_READ_BYTE(eeprom.password[i]);
-                    if (!storePassword()) { handleError(); return; }
-                } else {
-                    for (byte i = 0; i < PASSWORD_LEN; i++) SERIAL_READ();
-                }
-                break;
-
-            case SET_ALARMS:
-                SERIAL_READ_SIZE(tempByte);
-                tempByte /= 4;
-                if (tempByte > MAX_ALARMS) goto bad;
-                if (isPasswordCorrect) {
-                    eeprom.alarmCount = tempByte;
-                    for (byte i = 0; i < eeprom.alarmCount; i++) {
-                        SERIAL_READ_BYTE(tempByte); if (tempByte < 24) eeprom.alarms[i].hour = tempByte; else { getAlarms(); goto bad; }
-                        SERIAL_READ_BYTE(tempByte); if (tempByte < 60) eeprom.alarms[i].minute = tempByte; else { getAlarms(); goto bad; }
-                        SERIAL_READ_BYTE(tempByte); if (tempByte < 100) eeprom.alarms[i].duration = tempByte; else { getAlarms(); goto bad; }
-                        SERIAL_READ_BYTE(eeprom.alarms[i].days);
-                    }
-                    if (!storeAlarms()) { handleError(); return; }
-                } else {
-                    for (byte i = 0; i < tempByte; i++) { SERIAL_READ(); SERIAL_READ(); SERIAL_READ(); SERIAL_READ(); }
-                }
-                break;
-
-            case SET_DESCRIPTION:
-                SERIAL_READ_SIZE(tempByte);
-                if (tempByte > MAX_DESCRIPTION_LEN) goto bad;
-                if (isPasswordCorrect) {
-                    eeprom.descriptionLength = tempByte;
-                    for (byte i = 0; i < tempByte; i++) SERIAL_READ_BYTE(eeprom.description[i]);
-                    if (!storeDescription()) { handleError(); return; }
-                } else { for (byte i = 0; i < tempByte; i++) SERIAL_READ(); }
-                break;
-
-            case SET_AUTHOR:
-                SERIAL_READ_SIZE(tempByte);
-                if (tempByte > MAX_AUTHOR_LEN) goto bad;
-                if (isPasswordCorrect) {
-                    eeprom.authorLength = tempByte;
-                    for (byte i = 0; i < tempByte; i++) SERIAL_READ_BYTE(eeprom.author[i]);
-                    if (!storeAuthor()) { handleError(); return; }
-                } else { for (byte i = 0; i < tempByte; i++) SERIAL_READ(); }
-                break;
-
-            case SET_HOUR:
-                SERIAL_READ_BYTE_S(tempByte);
-                if (tempByte > 23) goto bad;
-                if (isPasswordCorrect) myRTC.setHour(tempByte);
-                break;
-            case SET_MINUTE:
-                SERIAL_READ_BYTE_S(tempByte);
-                if (tempByte > 59) goto bad;
-                if (isPasswordCorrect) myRTC.setMinute(tempByte);
-                break;
-            case SET_SECOND:
-                SERIAL_READ_BYTE_S(tempByte);
-                if (tempByte > 59) goto bad;
-                if (isPasswordCorrect) myRTC.setSecond(tempByte);
-                break;
-            case SET_DAY_OF_WEEK:
-                SERIAL_READ_BYTE_S(tempByte);
-                if (tempByte < 1 || tempByte > 7) goto bad;
-                if (isPasswordCorrect) myRTC.setDoW(tempByte);
-                break;
-            case SET_DAY:
-                SERIAL_READ_BYTE_S(tempByte);
-                if (tempByte < 1 || tempByte > 31) goto bad;
-                if (isPasswordCorrect) myRTC.setDate(tempByte);
-                break;
-            case SET_MONTH:
-                SERIAL_READ_BYTE_S(tempByte);
-                if (tempByte < 1 || tempByte > 12) goto bad;
-                if (isPasswordCorrect) myRTC.setMonth(tempByte);
-                break;
-            case SET_YEAR:
-                SERIAL_READ_BYTE_S(tempByte);
-                if (tempByte > 99) goto bad;
-                if (isPasswordCorrect) myRTC.setYear(tempByte);
-                break;
-            case SET_STATE:
-                SERIAL_READ_BYTE_S(tempByte);
-                if (isPasswordCorrect) {
-                    eeprom.state = tempByte;
-                    if (!storeState()) { handleError(); return; }
-                }
-                break;
-
-            // ------------------ Password Handling ------------------
-            case POST_PASSWORD:
-                showSuccessMsg=true;
-            case POST_PASSWORD_UPLOAD:
-            case POST_PASSWORD_CHANGE:
-                passwordSent = true;
-                if (size < PASSWORD_LEN) goto bad;
-                isPasswordCorrect = true;
-                for (byte i = 0; i < PASSWORD_LEN; i++) {
-                    byte b;
-                    SERIAL_READ_BYTE(b);
-                    if (eeprom.password[i] != b) isPasswordCorrect = false;
-                }
-                SERIAL_WRITE_BYTE(POST_PASSWORD_RESPONSE);
-                if(tempByte == POST_PASSWORD){
-                    SERIAL_WRITE_BYTE(isPasswordCorrect ? PASSWORD_RESPONSE_CORRECT : PASSWORD_RESPONSE_INCORRECT);
-                }else if(tempByte == POST_PASSWORD_UPLOAD){
-                    SERIAL_WRITE_BYTE(isPasswordCorrect ? PASSWORD_RESPONSE_UPLOAD : PASSWORD_RESPONSE_INCORRECT);
-                }else if(tempByte == POST_PASSWORD_CHANGE){
-                    SERIAL_WRITE_BYTE(isPasswordCorrect ? PASSWORD_RESPONSE_CHANGE : PASSWORD_RESPONSE_INCORRECT);
-                }
-                
-                if (isPasswordCorrect) preferences.begin(DB_NAME, false);
-                break;
-            default:
-                lcd.home(); lcd.clear();
-                tone(BUZZER, BUZZER_FREQ, MSG_DELAY);
-                lcd.print(tempByte);
-                delay(MSG_DELAY);
-                if (currentMenu == HOME) initHome(); else displayAlarm();
-        } // switch
-    } // while
+        if (parseState == WAIT_SIZE) {
+            byte header = protocolVersion == PROTOCOL_V1 ? 1 : protocolVersion == PROTOCOL_V2 ? 2 : 3;
+            if (ringCount() < header) return;
+
+            // v3: the CRC covers the header, start it before consuming it
+            if (protocolVersion == PROTOCOL_V3) requestCrc = ringCrc(header, 0xFFFF);
+
+            size = rxRing[rxTail++ & RX_RING_MASK]; // First byte(s) = total size
+            if (header >= 2) size |= rxRing[rxTail++ & RX_RING_MASK] << 8;
+            if (header == 3) requestSeq = rxRing[rxTail++ & RX_RING_MASK];
+            requestDeadline = millis() + REQUEST_TIMEOUT;
+            parseState = WAIT_PAYLOAD;
+
+            if (size > MAX_REQUEST_SIZE) {
+                sendCode(BAD_REQUEST);
+                serialFlush(); // Cannot resynchronize inside the request
+                return;
+            }
+        }
+
+        if (protocolVersion == PROTOCOL_V3) {
+            if (ringCount() < size + CRC_SIZE) return; // Wait until the whole frame is received
+
+            if (ringCrc(size, requestCrc) != ringPeek16(size)) {
+                FLUSH_REQUEST();
+                sendCode(CRC_ERROR); // The request is not executed
+            } else {
+                handleRequest();
+            }
+            rxTail += CRC_SIZE;
+        } else {
+            if (ringCount() < size) return; // Wait until the whole request is received
+
+            handleRequest();
+        }
+        parseState = WAIT_SIZE;
+        protocolVersion = nextProtocolVersion;
+        if (sessionClosing) endSession();
+        fillRing();
+    }
+}
+
+// ============================================================================
+//   Request Context
+//   State of the request being executed, shared by the opcode handlers.
+// ============================================================================
+struct Request {
+    byte idx;                // Write index in txBuffer, first bytes reserved for the header
+    bool overflow;           // v1: txBuffer overflowed and BUFFER_OVERFLOW was sent
+    bool authorized;         // Password or session token accepted
+    bool passwordSent;       // A password, login or token was checked
+    bool showSuccessMsg;     // POST_PASSWORD: show SUCCESS if authorized
+    bool dirty;              // eeprom changed, stored once the request is executed
+    bool storageOpen;        // preferences.begin() succeeded for this request (no session)
+    ClockTime clock;         // Time fields of a request all come from this one snapshot
+};
+
+// State once the commands validated so far are executed
+struct FrameCheck {
+    uint16_t alarmCount;
+    byte uploadNext;         // See uploadNext
+    uint16_t uploadCount;
+    bool uploadBroken;       // A page came out of order: the staged upload is dropped
+};
+
+enum CommandStatus {
+    COMMAND_OK,
+    COMMAND_BAD,             // Rejected, nothing changed: BAD_REQUEST
+    COMMAND_ERROR            // Device failure: ERROR
+};
+
+// Payload length of a command starting at ring position `at`, `left` bytes
+// remain in the request. More than `left` means the command is truncated.
+typedef uint32_t (*PayloadLength)(uint16_t at, uint16_t left);
+typedef bool (*Validator)(uint16_t at, FrameCheck &check);
+typedef CommandStatus (*Handler)(Request &req, byte code);
+
+struct Opcode {
+    byte code;               // Must equal the index in opcodes[]
+    uint16_t fixed;          // Payload length when `length` is NULL
+    PayloadLength length;    // Payload length read from the frame
+    bool auth;               // Skipped, payload dropped, unless authorized
+    Validator validate;      // NULL: any payload of the right length
+    Handler handle;          // NULL: not a request, the code is shown on the LCD
+};
+
+#define BAD_LENGTH 0xFFFFFFFFUL
+
+// ============================================================================
+//   Frame Access
+//   Validators peek at ring positions; handlers consume the payload.
+// ============================================================================
+static byte ringByte(uint16_t at) {
+    return rxRing[at & RX_RING_MASK];
+}
+
+static uint16_t ringWord(uint16_t at) {
+    return ringByte(at) | ringByte(at + 1) << 8;
+}
+
+static Alarm ringAlarm(uint16_t at) {
+    Alarm alarm = 0;
+    for (byte b = 0; b < sizeof(Alarm); b++) alarm |= (uint32_t)ringByte(at + b) << (8 * b);
+    return alarm;
+}
+
+// Length prefix of a variable-size field: 1 byte in v1, 2 bytes (little-endian) after
+static byte lengthSize() {
+    return protocolVersion == PROTOCOL_V1 ? 1 : 2;
+}
+
+static uint16_t ringLength(uint16_t at) {
+    return lengthSize() == 1 ? ringByte(at) : ringWord(at);
+}
+
+static uint16_t readWord() {
+    uint16_t x = requestRead();
+    return x | requestRead() << 8;
+}
+
+static uint16_t readLength() {
+    return lengthSize() == 1 ? requestRead() : readWord();
+}
+
+static Alarm readAlarm() {
+    Alarm alarm = ringAlarm(rxTail);
+    rxTail += sizeof(Alarm);
+    size -= sizeof(Alarm);
+    return alarm;
+}
+
+// Append to the response. When txBuffer is full, v1 answers BUFFER_OVERFLOW
+// and drops the rest; later versions send it as a chunk of the response.
+static void put(Request &req, byte x) {
+    if (req.overflow) return;
+    if (req.idx >= TX_BUFFER_SIZE) {
+        if (protocolVersion == PROTOCOL_V1) {
+            sendCode(BUFFER_OVERFLOW);
+            req.overflow = true;
+            return;
+        }
+        req.idx = sendResponse(req.idx, true);
+    }
+    txBuffer[req.idx++] = x;
+}
+
+static void putWord(Request &req, uint16_t x) {
+    put(req, x & 0xFF);
+    put(req, x >> 8);
+}
+
+static void putLong(Request &req, uint32_t x) {
+    for (byte b = 0; b < 4; b++) put(req, (x >> (8 * b)) & 0xFF);
+}
+
+static void putLength(Request &req, uint16_t x) {
+    if (lengthSize() == 1) put(req, x);
+    else putWord(req, x);
+}
+
+// ============================================================================
+//   Payload Lengths
+// ============================================================================
+
+// Newer clients follow CONNECTED with a version magic byte; v1 clients never send it
+static uint32_t connectedLength(uint16_t at, uint16_t left) {
+    return left > 0 && (ringByte(at) == PROTOCOL_V2_MAGIC || ringByte(at) == PROTOCOL_V3_MAGIC) ? 1 : 0;
+}
+
+// [length][length bytes]
+static uint32_t prefixedLength(uint16_t at, uint16_t left) {
+    return left < lengthSize() ? BAD_LENGTH : lengthSize() + (uint32_t)ringLength(at);
+}
+
+// [page][count low][count high][n][n packed alarms]
+static uint32_t alarmsPageLength(uint16_t at, uint16_t left) {
+    return left < 4 ? BAD_LENGTH : 4 + ringByte(at + 3) * sizeof(Alarm);
+}
+
+// [index low][index high][n][n packed alarms]
+static uint32_t alarmEditLength(uint16_t at, uint16_t left) {
+    return left < 3 ? BAD_LENGTH : 3 + ringByte(at + 2) * sizeof(Alarm);
+}
+
+// ============================================================================
+//   Validators
+//   Run on the whole request before its first command is executed, so an
+//   invalid value never leaves a half-applied change behind.
+// ============================================================================
+template <byte low, byte high>
+static bool validateRange(uint16_t at, FrameCheck &check) {
+    return ringByte(at) >= low && ringByte(at) <= high;
+}
+
+template <uint16_t maxLength>
+static bool validateText(uint16_t at, FrameCheck &check) {
+    return ringLength(at) <= maxLength;
+}
+
+static bool validatePackedAlarms(uint16_t at, uint16_t n) {
+    for (uint16_t i = 0; i < n; i++) {
+        if (!isAlarmValid(ringAlarm(at + i * sizeof(Alarm)))) return false;
+    }
+    return true;
+}
+
+// [length][hour][minute][duration][days] * length / 4
+static bool validateAlarms(uint16_t at, FrameCheck &check) {
+    uint16_t length = ringLength(at);
+    at += lengthSize();
+    if (length % 4 != 0 || length / 4 > MAX_ALARMS) return false;
+
+    for (uint16_t i = 0; i < length; i += 4) {
+        if (ringByte(at + i) >= 24 || ringByte(at + i + 1) >= 60 || ringByte(at + i + 2) >= 100) return false;
+    }
+    check.alarmCount = length / 4;
+    return true;
+}
+
+static bool validateAlarmsPage(uint16_t at, FrameCheck &check) {
+    byte page = ringByte(at);
+    uint16_t first = page * ALARMS_PAGE_SIZE;
+    uint16_t count = ringWord(at + 1);
+    byte n = ringByte(at + 3);
+
+    if (count > MAX_ALARMS) return false;
+    if (n != (first < count ? min<uint16_t>(ALARMS_PAGE_SIZE, count - first) : 0)) return false;
+    if (n == 0 && count != 0) return false;
+    if (!validatePackedAlarms(at + 4, n)) return false;
+
+    // Pages come in order from page 0, all announcing the same count
+    if (page != 0 && (page != check.uploadNext || count != check.uploadCount)) {
+        check.uploadBroken = true;
+        return false;
+    }
+    check.uploadCount = count;
+    check.uploadNext = page + 1;
+    if (first + n == count) { // Last page: the table is replaced
+        check.alarmCount = count;
+        check.uploadNext = 0;
+    }
+    return true;
+}
+
+static bool validateUpdate(uint16_t at, FrameCheck &check) {
+    uint16_t index = ringWord(at);
+    byte n = ringByte(at + 2);
+    return index + n <= check.alarmCount && validatePackedAlarms(at + 3, n);
+}
+
+static bool validateInsert(uint16_t at, FrameCheck &check) {
+    uint16_t index = ringWord(at);
+    byte n = ringByte(at + 2);
+    if (index > check.alarmCount || check.alarmCount + n > MAX_ALARMS) return false;
+    if (!validatePackedAlarms(at + 3, n)) return false;
+
+    check.alarmCount += n;
+    return true;
+}
+
+// [index low][index high][n low][n high]
+static bool validateDelete(uint16_t at, FrameCheck &check) {
+    uint16_t index = ringWord(at);
+    uint16_t n = ringWord(at + 2);
+    if (n == 0 || index >= check.alarmCount || n > check.alarmCount - index) return false;
+
+    check.alarmCount -= n;
+    return true;
+}
+
+// [year 0-99][month][day][day of week][hour][minute][second]
+static bool validateDateTime(uint16_t at, FrameCheck &check) {
+    static const byte low[7] = {0, 1, 1, 1, 0, 0, 0};
+    static const byte high[7] = {99, 12, 31, 7, 23, 59, 59};
+
+    for (byte i = 0; i < 7; i++) {
+        byte value = ringByte(at + i);
+        if (value < low[i] || value > high[i]) return false;
+    }
+    return ringByte(at + 2) <= daysInMonth(ringByte(at + 1), ringByte(at) + 1970); // No February 30
+}
+
+// ============================================================================
+//   Handlers: Connection Events
+// ============================================================================
+static CommandStatus handleConnected(Request &req, byte code) {
+    postMessage("   CONNECTED    ", NULL, 2);
+    sessionClosing = true; // A new connection never inherits a session
+    resetSubscriptions(0);
+    dropUpload();
+
+    nextProtocolVersion = PROTOCOL_V1;
+    if (connectedLength(rxTail, size) == 1) {
+        nextProtocolVersion = requestRead() == PROTOCOL_V2_MAGIC ? PROTOCOL_V2 : PROTOCOL_V3;
+        put(req, SET_PROTOCOL_VERSION);
+        put(req, nextProtocolVersion);
+    }
+    return COMMAND_OK;
+}
+
+static CommandStatus handleDisconnected(Request &req, byte code) {
+    postMessage("  DISCONNECTED  ", NULL, 2);
+    nextProtocolVersion = PROTOCOL_V1;
+    sessionClosing = true;
+    resetSubscriptions(0);
+    dropUpload();
+    transport->close(); // Releases links without a connection state (UART)
+    return COMMAND_OK;
+}
+
+// ============================================================================
+//   Handlers: GET Commands
+// ============================================================================
+static CommandStatus handleGetProgramType(Request &req, byte code) {
+    put(req, SET_PROGRAM_TYPE);
+    put(req, eeprom.programType);
+    return COMMAND_OK;
+}
+
+static CommandStatus handleGetAlarms(Request &req, byte code) {
+    put(req, SET_ALARMS);
+    putLength(req, 4 * eeprom.alarmCount);
+    for (uint16_t i = 0; i < eeprom.alarmCount && !req.overflow; i++) {
+        put(req, alarmHour(eeprom.alarms[i]));
+        put(req, alarmMinute(eeprom.alarms[i]));
+        put(req, alarmDuration(eeprom.alarms[i]));
+        put(req, alarmDays(eeprom.alarms[i]));
+    }
+    return COMMAND_OK;
+}
+
+static CommandStatus handleGetAlarmsPage(Request &req, byte code) {
+    byte page = requestRead();
+    uint16_t first = page * ALARMS_PAGE_SIZE;
+    byte n = first < eeprom.alarmCount ? min<uint16_t>(ALARMS_PAGE_SIZE, eeprom.alarmCount - first) : 0;
+
+    put(req, SET_ALARMS_PAGE);
+    put(req, page);
+    putWord(req, eeprom.alarmCount);
+    put(req, n);
+    for (byte i = 0; i < n; i++) putLong(req, eeprom.alarms[first + i]);
+    return COMMAND_OK;
+}
+
+static CommandStatus handleGetDescription(Request &req, byte code) {
+    put(req, SET_DESCRIPTION);
+    putLength(req, eeprom.descriptionLength);
+    for (byte i = 0; i < eeprom.descriptionLength; i++) put(req, eeprom.description[i]);
+    return COMMAND_OK;
+}
+
+static CommandStatus handleGetAuthor(Request &req, byte code) {
+    put(req, SET_AUTHOR);
+    putLength(req, eeprom.authorLength);
+    for (byte i = 0; i < eeprom.authorLength; i++) put(req, eeprom.author[i]);
+    return COMMAND_OK;
+}
+
+// GET_HOUR ... GET_TEMPERATURE: answered with the matching SET code
+static CommandStatus handleGetClockField(Request &req, byte code) {
+    const ClockTime &clock = req.clock;
+    switch (code) {
+        case GET_HOUR: put(req, SET_HOUR); put(req, clock.hour); break;
+        case GET_MINUTE: put(req, SET_MINUTE); put(req, clock.minute); break;
+        case GET_SECOND: put(req, SET_SECOND); put(req, clock.second); break;
+        case GET_DAY_OF_WEEK: put(req, SET_DAY_OF_WEEK); put(req, clock.dayOfWeek); break;
+        case GET_DAY: put(req, SET_DAY); put(req, clock.day); break;
+        case GET_MONTH: put(req, SET_MONTH); put(req, clock.month); break;
+        case GET_YEAR: put(req, SET_YEAR); put(req, clock.year - 1970); break;
+        case GET_TEMPERATURE: put(req, SET_TEMPERATURE); put(req, clock.temperature); break;
+    }
+    return COMMAND_OK;
+}
+
+static void putDateTime(Request &req) {
+    put(req, req.clock.year - 1970);
+    put(req, req.clock.month);
+    put(req, req.clock.day);
+    put(req, req.clock.dayOfWeek);
+    put(req, req.clock.hour);
+    put(req, req.clock.minute);
+    put(req, req.clock.second);
+}
+
+// [year 0-99][month][day][day of week][hour][minute][second]
+static CommandStatus handleGetDateTime(Request &req, byte code) {
+    put(req, SET_DATETIME);
+    putDateTime(req);
+    return COMMAND_OK;
+}
+
+// Date and time, then [temperature][state][program type][alarm count: 2][schedule version: 2]
+static CommandStatus handleGetStatus(Request &req, byte code) {
+    put(req, SET_STATUS);
+    putDateTime(req);
+    put(req, req.clock.temperature);
+    put(req, eeprom.state);
+    put(req, eeprom.programType);
+    putWord(req, eeprom.alarmCount);
+    putWord(req, scheduleVersion());
+    return COMMAND_OK;
+}
+
+static CommandStatus handleGetClockAge(Request &req, byte code) {
+    put(req, SET_CLOCK_AGE);
+    putWord(req, min<uint32_t>(ticks - req.clock.tick, 0xFFFF));
+    return COMMAND_OK;
+}
+
+static CommandStatus handleGetState(Request &req, byte code) {
+    put(req, SET_STATE);
+    put(req, eeprom.state);
+    return COMMAND_OK;
+}
+
+static CommandStatus handleGetMissedTicks(Request &req, byte code) {
+    put(req, SET_MISSED_TICKS);
+    putLong(req, missedTicks);
+    return COMMAND_OK;
+}
+
+static CommandStatus handleGetOnsetLatency(Request &req, byte code) {
+    put(req, SET_ONSET_LATENCY);
+    putLong(req, getOnsetLatency());
+    return COMMAND_OK;
+}
+
+// ============================================================================
+//   Handlers: SET Commands
+//   Only called for authorized requests, with a validated payload. Changes
+//   are stored together, in one write, once the whole request is executed.
+// ============================================================================
+static CommandStatus handleSetProgramType(Request &req, byte code) {
+    eeprom.programType = requestRead();
+    compileSchedule();
+    notifyAlarmsChanged(); // The alarm screen shows durations or ON/OFF
+    req.dirty = true;
+    return COMMAND_OK;
+}
+
+static CommandStatus handleSetPassword(Request &req, byte code) {
+    for (byte i = 0; i < PASSWORD_LEN; i++) eeprom.password[i] = requestRead();
+    req.dirty = true;
+    return COMMAND_OK;
+}
+
+static CommandStatus handleSetAlarms(Request &req, byte code) {
+    uint16_t count = readLength() / 4;
+
+    eeprom.alarmCount = count;
+    for (uint16_t i = 0; i < count; i++) {
+        byte hour = requestRead();
+        byte minute = requestRead();
+        byte seconds = requestRead();
+        byte days = requestRead();
+        eeprom.alarms[i] = packAlarm(hour, minute, seconds, days);
+    }
+    markAlarmsDirty(0, count);
+    compileSchedule();
+    notifyAlarmsChanged();
+    req.dirty = true;
+    return COMMAND_OK;
+}
+
+// Pages are staged until the last one, so the scheduler and the flash only
+// ever see a complete table
+static CommandStatus handleSetAlarmsPage(Request &req, byte code) {
+    byte page = ringByte(rxTail);
+    uint16_t count = ringWord(rxTail + 1);
+
+    // See handleEditAlarms(): a page skipped for lack of authorization breaks the order
+    if (page != 0 && (page != uploadNext || count != uploadCount)) {
+        dropUpload();
+        return COMMAND_BAD;
+    }
+    requestRead();
+    readWord();
+    byte n = requestRead();
+    uint16_t first = page * ALARMS_PAGE_SIZE;
+
+    for (byte i = 0; i < n; i++) uploadAlarms[first + i] = readAlarm();
+    uploadCount = count;
+    uploadNext = page + 1;
+    if (first + n < count) return COMMAND_OK; // More pages to come
+
+    dropUpload();
+    memcpy(eeprom.alarms, uploadAlarms, count * sizeof(Alarm));
+    eeprom.alarmCount = count;
+    markAlarmsDirty(0, count);
+    compileSchedule();
+    notifyAlarmsChanged();
+    req.dirty = true;
+    return COMMAND_OK;
+}
+
+// [index low][index high][n][n packed alarms]
+static CommandStatus handleEditAlarms(Request &req, byte code) {
+    uint16_t index = ringWord(rxTail);
+    byte n = ringByte(rxTail + 2);
+    uint16_t count = eeprom.alarmCount;
+
+    // The validator counted the edits of the whole request; this only fails
+    // if authorization was lost in the middle of it
+    if (code == UPDATE_ALARMS && index + n > count) return COMMAND_BAD;
+    if (code == INSERT_ALARMS && (index > count || count + n > MAX_ALARMS)) return COMMAND_BAD;
+    readWord();
+    requestRead();
+
+    if (code == INSERT_ALARMS) {
+        memmove(&eeprom.alarms[index + n], &eeprom.alarms[index], (count - index) * sizeof(Alarm));
+        eeprom.alarmCount += n;
+    }
+    for (byte i = 0; i < n; i++) eeprom.alarms[index + i] = readAlarm();
+
+    // An insert shifts the alarms after it, an update stays in place
+    markAlarmsDirty(index, code == INSERT_ALARMS ? eeprom.alarmCount : index + n);
+    compileSchedule();
+    notifyAlarmsChanged();
+    req.dirty = true;
+    return COMMAND_OK;
+}
+
+// [index low][index high][n low][n high]
+static CommandStatus handleDeleteAlarms(Request &req, byte code) {
+    uint16_t index = ringWord(rxTail);
+    uint16_t n = ringWord(rxTail + 2);
+    uint16_t count = eeprom.alarmCount;
+
+    if (n == 0 || index >= count || n > count - index) return COMMAND_BAD; // See handleEditAlarms()
+    readWord();
+    readWord();
+
+    memmove(&eeprom.alarms[index], &eeprom.alarms[index + n], (count - index - n) * sizeof(Alarm));
+    eeprom.alarmCount -= n;
+    markAlarmsDirty(index, eeprom.alarmCount);
+    compileSchedule();
+    notifyAlarmsChanged();
+    req.dirty = true;
+    return COMMAND_OK;
+}
+
+static CommandStatus handleSetDescription(Request &req, byte code) {
+    eeprom.descriptionLength = readLength();
+    for (byte i = 0; i < eeprom.descriptionLength; i++) eeprom.description[i] = requestRead();
+    req.dirty = true;
+    return COMMAND_OK;
+}
+
+static CommandStatus handleSetAuthor(Request &req, byte code) {
+    eeprom.authorLength = readLength();
+    for (byte i = 0; i < eeprom.authorLength; i++) eeprom.author[i] = requestRead();
+    req.dirty = true;
+    return COMMAND_OK;
+}
+
+// SET_HOUR ... SET_YEAR
+static CommandStatus handleSetClockField(Request &req, byte code) {
+    byte value = requestRead();
+    switch (code) {
+        case SET_HOUR: RTC_SET(myRTC.setHour(value)); break;
+        case SET_MINUTE: RTC_SET(myRTC.setMinute(value)); break;
+        case SET_SECOND: RTC_SET(myRTC.setSecond(value)); break;
+        case SET_DAY_OF_WEEK: RTC_SET(myRTC.setDoW(value)); break;
+        case SET_DAY: RTC_SET(myRTC.setDate(value)); break;
+        case SET_MONTH: RTC_SET(myRTC.setMonth(value)); break;
+        case SET_YEAR: RTC_SET(myRTC.setYear(value)); break;
+    }
+    return COMMAND_OK;
+}
+
+static CommandStatus handleSetDateTime(Request &req, byte code) {
+    ClockTime time;
+    time.year = requestRead() + 1970;
+    time.month = requestRead();
+    time.day = requestRead();
+    time.dayOfWeek = requestRead();
+    time.hour = requestRead();
+    time.minute = requestRead();
+    time.second = requestRead();
+    return setClock(time) ? COMMAND_OK : COMMAND_ERROR;
+}
+
+static CommandStatus handleSetState(Request &req, byte code) {
+    eeprom.state = requestRead();
+    compileSchedule();
+    req.dirty = true;
+    return COMMAND_OK;
+}
+
+// ============================================================================
+//   Handlers: Password, Events and Sessions
+// ============================================================================
+
+// POST_PASSWORD, POST_PASSWORD_UPLOAD and POST_PASSWORD_CHANGE
+static CommandStatus handlePostPassword(Request &req, byte code) {
+    req.passwordSent = true;
+    if (code == POST_PASSWORD) req.showSuccessMsg = true;
+
+    req.authorized = true;
+    for (byte i = 0; i < PASSWORD_LEN; i++) {
+        if (eeprom.password[i] != requestRead()) req.authorized = false;
+    }
+
+    byte granted = code == POST_PASSWORD ? PASSWORD_RESPONSE_CORRECT :
+                   code == POST_PASSWORD_UPLOAD ? PASSWORD_RESPONSE_UPLOAD : PASSWORD_RESPONSE_CHANGE;
+    put(req, POST_PASSWORD_RESPONSE);
+    put(req, req.authorized ? granted : (byte)PASSWORD_RESPONSE_INCORRECT);
+
+    if (req.authorized && sessionToken == NO_SESSION && !req.storageOpen) {
+        req.storageOpen = preferences.begin(DB_NAME, false);
+    }
+    return COMMAND_OK;
+}
+
+static CommandStatus handleSubscribe(Request &req, byte code) {
+    resetSubscriptions(requestRead());
+    put(req, SUBSCRIBE);
+    put(req, subscriptions);
+    return COMMAND_OK;
+}
+
+static CommandStatus handleGetChallenge(Request &req, byte code) {
+    esp_fill_random(challenge, CHALLENGE_LEN);
+    challengeIssued = true;
+    put(req, SET_CHALLENGE);
+    for (byte i = 0; i < CHALLENGE_LEN; i++) put(req, challenge[i]);
+    return COMMAND_OK;
+}
+
+static CommandStatus handlePostLogin(Request &req, byte code) {
+    byte answer[32];
+    for (byte i = 0; i < sizeof(answer); i++) answer[i] = requestRead();
+
+    bool ok = challengeIssued && checkLogin(answer);
+    challengeIssued = false; // One attempt per challenge
+    req.passwordSent = true;
+
+    if (ok) {
+        if (sessionToken == NO_SESSION && !req.storageOpen) preferences.begin(DB_NAME, false);
+        req.storageOpen = false; // NVS now stays open until the session ends
+        do { sessionToken = esp_random(); } while (sessionToken == NO_SESSION);
+        sessionClosing = false;
+        req.authorized = true;
+    }
+    put(req, SET_SESSION);
+    putLong(req, ok ? sessionToken : 0);
+    return COMMAND_OK;
+}
+
+static CommandStatus handlePostSession(Request &req, byte code) {
+    uint32_t token = readWord();
+    token |= (uint32_t)readWord() << 16;
+
+    req.authorized = sessionToken != NO_SESSION && token == sessionToken;
+    if (!req.authorized) {
+        req.passwordSent = true;
+        put(req, POST_PASSWORD_RESPONSE);
+        put(req, PASSWORD_RESPONSE_INCORRECT);
+    }
+    return COMMAND_OK;
+}
+
+// ============================================================================
+//   Opcode Table
+//   One entry per RequestCodes value, in enum order, so dispatch is a single
+//   index. Codes only sent by the device have no handler.
+// ============================================================================
+constexpr Opcode opcodes[] = {
+    // code                  payload        length            auth   validator                  handler
+    {CONNECTED,              0,             connectedLength,  false, NULL,                      handleConnected},
+    {GET_ALARMS,             0,             NULL,             false, NULL,                      handleGetAlarms},
+    {GET_DESCRIPTION,        0,             NULL,             false, NULL,                      handleGetDescription},
+    {GET_AUTHOR,             0,             NULL,             false, NULL,                      handleGetAuthor},
+    {GET_HOUR,               0,             NULL,             false, NULL,                      handleGetClockField},
+    {GET_MINUTE,             0,             NULL,             false, NULL,                      handleGetClockField},
+    {GET_SECOND,             0,             NULL,             false, NULL,                      handleGetClockField},
+    {GET_DAY_OF_WEEK,        0,             NULL,             false, NULL,                      handleGetClockField},
+    {GET_DAY,                0,             NULL,             false, NULL,                      handleGetClockField},
+    {GET_MONTH,              0,             NULL,             false, NULL,                      handleGetClockField},
+    {GET_YEAR,               0,             NULL,             false, NULL,                      handleGetClockField},
+    {GET_TEMPERATURE,        0,             NULL,             false, NULL,                      handleGetClockField},
+    {GET_STATE,              0,             NULL,             false, NULL,                      handleGetState},
+    {SET_PASSWORD,           PASSWORD_LEN,  NULL,             true,  NULL,                      handleSetPassword},
+    {SET_ALARMS,             0,             prefixedLength,   true,  validateAlarms,            handleSetAlarms},
+    {SET_DESCRIPTION,        0,             prefixedLength,   true,  validateText<MAX_DESCRIPTION_LEN>, handleSetDescription},
+    {SET_AUTHOR,             0,             prefixedLength,   true,  validateText<MAX_AUTHOR_LEN>, handleSetAuthor},
+    {SET_HOUR,               1,             NULL,             true,  validateRange<0, 23>,      handleSetClockField},
+    {SET_MINUTE,             1,             NULL,             true,  validateRange<0, 59>,      handleSetClockField},
+    {SET_SECOND,             1,             NULL,             true,  validateRange<0, 59>,      handleSetClockField},
+    {SET_DAY_OF_WEEK,        1,             NULL,             true,  validateRange<1, 7>,       handleSetClockField},
+    {SET_DAY,                1,             NULL,             true,  validateRange<1, 31>,      handleSetClockField},
+    {SET_MONTH,              1,             NULL,             true,  validateRange<1, 12>,      handleSetClockField},
+    {SET_YEAR,               1,             NULL,             true,  validateRange<0, 99>,      handleSetClockField},
+    {SET_TEMPERATURE,        0,             NULL,             false, NULL,                      NULL},
+    {SET_STATE,              1,             NULL,             true,  NULL,                      handleSetState},
+    {POST_PASSWORD,          PASSWORD_LEN,  NULL,             false, NULL,                      handlePostPassword},
+    {POST_PASSWORD_CHANGE,   PASSWORD_LEN,  NULL,             false, NULL,                      handlePostPassword},
+    {POST_PASSWORD_UPLOAD,   PASSWORD_LEN,  NULL,             false, NULL,                      handlePostPassword},
+    {POST_PASSWORD_RESPONSE, 0,             NULL,             false, NULL,                      NULL},
+    {BUFFER_OVERFLOW,        0,             NULL,             false, NULL,                      NULL},
+    {BAD_REQUEST,            0,             NULL,             false, NULL,                      NULL},
+    {TIMEOUT,                0,             NULL,             false, NULL,                      NULL},
+    {SET_PROGRAM_TYPE,       1,             NULL,             true,  NULL,                      handleSetProgramType},
+    {GET_PROGRAM_TYPE,       0,             NULL,             false, NULL,                      handleGetProgramType},
+    {DISCONNECTED,           0,             NULL,             false, NULL,                      handleDisconnected},
+    {ERROR,                  0,             NULL,             false, NULL,                      NULL},
+    {GET_ALARMS_PAGE,        1,             NULL,             false, NULL,                      handleGetAlarmsPage},
+    {SET_ALARMS_PAGE,        0,             alarmsPageLength, true,  validateAlarmsPage,        handleSetAlarmsPage},
+    {GET_MISSED_TICKS,       0,             NULL,             false, NULL,                      handleGetMissedTicks},
+    {SET_MISSED_TICKS,       0,             NULL,             false, NULL,                      NULL},
+    {GET_ONSET_LATENCY,      0,             NULL,             false, NULL,                      handleGetOnsetLatency},
+    {SET_ONSET_LATENCY,      0,             NULL,             false, NULL,                      NULL},
+    {GET_CLOCK_AGE,          0,             NULL,             false, NULL,                      handleGetClockAge},
+    {SET_CLOCK_AGE,          0,             NULL,             false, NULL,                      NULL},
+    {SET_PROTOCOL_VERSION,   0,             NULL,             false, NULL,                      NULL},
+    {UPDATE_ALARMS,          0,             alarmEditLength,  true,  validateUpdate,            handleEditAlarms},
+    {INSERT_ALARMS,          0,             alarmEditLength,  true,  validateInsert,            handleEditAlarms},
+    {DELETE_ALARMS,          4,             NULL,             true,  validateDelete,            handleDeleteAlarms},
+    {GET_DATETIME,           0,             NULL,             false, NULL,                      handleGetDateTime},
+    {SET_DATETIME,           7,             NULL,             true,  validateDateTime,          handleSetDateTime},
+    {GET_STATUS,             0,             NULL,             false, NULL,                      handleGetStatus},
+    {SET_STATUS,             0,             NULL,             false, NULL,                      NULL},
+    {CRC_ERROR,              0,             NULL,             false, NULL,                      NULL},
+    {GET_CHALLENGE,          0,             NULL,             false, NULL,                      handleGetChallenge},
+    {SET_CHALLENGE,          0,             NULL,             false, NULL,                      NULL},
+    {POST_LOGIN,             32,            NULL,             false, NULL,                      handlePostLogin},
+    {SET_SESSION,            0,             NULL,             false, NULL,                      NULL},
+    {POST_SESSION,           TOKEN_LEN,     NULL,             false, NULL,                      handlePostSession},
+    {SUBSCRIBE,              1,             NULL,             false, NULL,                      handleSubscribe},
+    {EVENT,                  0,             NULL,             false, NULL,                      NULL},
+};
+
+constexpr bool opcodesInOrder(unsigned i) {
+    return i == REQUEST_CODE_COUNT || (opcodes[i].code == i && opcodesInOrder(i + 1));
+}
+static_assert(sizeof(opcodes) / sizeof(opcodes[0]) == REQUEST_CODE_COUNT, "opcodes[] must cover every request code");
+static_assert(opcodesInOrder(0), "opcodes[] must follow the order of RequestCodes");
+
+// Codes past the table: no payload, shown on the LCD
+static const Opcode unknownOpcode = {0, 0, NULL, false, NULL, NULL};
+
+static const Opcode &opcodeFor(byte code) {
+    return code < REQUEST_CODE_COUNT ? opcodes[code] : unknownOpcode;
+}
+
+static uint32_t payloadLength(const Opcode &op, uint16_t at, uint16_t left) {
+    return op.length != NULL ? op.length(at, left) : op.fixed;
+}
+
+// ============================================================================
+//   Request Validation
+//   Walks the request without consuming it: every command must be complete
+//   and pass its validator. Nothing is executed if one of them fails.
+// ============================================================================
+static bool validateRequest(FrameCheck &check) {
+    uint16_t at = rxTail;
+    uint16_t left = size;
+
+    while (left > 0) {
+        const Opcode &op = opcodeFor(ringByte(at));
+        at++;
+        left--;
+
+        uint32_t length = payloadLength(op, at, left);
+        if (length > left) return false;
+        if (op.validate != NULL && !op.validate(at, check)) return false;
+        at += length;
+        left -= length;
+    }
+    return true;
+}
+
+// ============================================================================
+//   Request Handler
+//   Validates the whole request, then executes its commands in order from
+//   the receive ring.
+// ============================================================================
+static void handleRequest() {
+    Request req = {};
+    req.idx = TX_HEADER_SIZE;
+    req.clock = getClock(); // No I2C access while the request runs
+    FrameCheck check = {eeprom.alarmCount, uploadNext, uploadCount, false};
+
+    if (!validateRequest(check)) {
+        if (check.uploadBroken) dropUpload();
+        goto bad;
+    }
+
+    while (size > 0) {
+        byte code = requestRead();
+        const Opcode &op = opcodeFor(code);
+        uint16_t length = payloadLength(op, rxTail, size);
+        uint16_t next = rxTail + length;
+        uint16_t rest = size - length;
+
+        if (op.handle == NULL) {
+            char text[4];
+            snprintf(text, sizeof(text), "%u", code);
+            postMessage(text, NULL, 0, MSG_DELAY);
+        } else if (!op.auth || req.authorized) {
+            CommandStatus status = op.handle(req, code);
+            if (status == COMMAND_BAD) goto bad;
+            if (status == COMMAND_ERROR) goto error;
+        }
+        rxTail = next; // Skips the payload of unauthorized commands
+        size = rest;
+        if (req.overflow) break;
+    }
+
+    // Everything the request changed is stored in one atomic write
+    if (req.dirty) {
+        req.dirty = false;
+        if (!storeRecord()) goto error;
+    }
+    goto end;
+
+error:
+    if (protocolVersion != PROTOCOL_V1 && req.idx > TX_HEADER_SIZE) req.idx = sendResponse(req.idx, true);
+    handleError();
+    req.idx = TX_HEADER_SIZE;
+    goto end;
 
 bad:
-    SerialBT.write(0x01);
-    SerialBT.write(BAD_REQUEST);
-    SerialBT.flush();
+    // v2: what was answered so far goes first, the status frame ends the response
+    if (protocolVersion != PROTOCOL_V1 && req.idx > TX_HEADER_SIZE) req.idx = sendResponse(req.idx, true);
+    sendCode(BAD_REQUEST);
 
 end:
-    if (idx > 1) {
-        txBuffer[0] = idx - 1;
-        SerialBT.write(txBuffer, idx);
-        SerialBT.flush();
+    if (req.dirty) storeRecord(); // A command failed after earlier ones changed eeprom
+
+    if (req.idx > TX_HEADER_SIZE || responseOpen) {
+        sendResponse(req.idx, false);
     }
 
-    if (isPasswordCorrect) preferences.end();
+    // Closed even if a later wrong password revoked the authorization
+    if (req.storageOpen) preferences.end();
+    if (req.authorized) requestWakeup(); // Schedule, state or clock may have changed
     FLUSH_REQUEST();
 
     // ------------------ Feedback on LCD ------------------
-    if (showSuccessMsg && isPasswordCorrect) {
-        lcd.home(); lcd.clear();
-        tone(BUZZER, BUZZER_FREQ, 200);
-        lcd.print("      DONE      ");
-        lcd.setCursor(0,1); lcd.print("    SUCCESS !   ");
-        delay(300); tone(BUZZER, BUZZER_FREQ, 200); delay(MSG_DELAY);
-        if (currentMenu == HOME) initHome(); else displayAlarm();
+    if (req.showSuccessMsg && req.authorized) {
+        postMessage("      DONE      ", "    SUCCESS !   ", 2);
+    }
+
+    if (req.passwordSent && !req.authorized) {
+        postMessage(" WRONG PASSWORD ", NULL, 2);
+    }
+}
+
+// ============================================================================
+//   Pushed Events
+//   Sent between requests. Clock and state are compared with what was last
+//   pushed, so a slow client gets the latest value instead of a backlog;
+//   queued events that did not fit are reported with EVENT_LOST.
+// ============================================================================
+static void sendEvent(byte type, const byte *data, byte length) {
+    byte idx = TX_HEADER_SIZE;
+    txBuffer[idx++] = EVENT;
+    txBuffer[idx++] = type;
+    for (byte i = 0; i < length; i++) txBuffer[idx++] = data[i];
+
+    byte seq = requestSeq; // A partial request may be pending
+    requestSeq = EVENT_SEQ;
+    sendResponse(idx, false);
+    requestSeq = seq;
+}
+
+void serviceEvents() {
+    Event event;
+    byte data[3];
+
+    // Queued events are always drained, even without subscribers
+    while (takeEvent(event)) {
+        bool alarm = event.type == EVENT_ALARM_FIRED || event.type == EVENT_ALARM_ENDED;
+        if ((alarm && (subscriptions & SUBSCRIBE_ALARMS)) ||
+            (event.type == EVENT_RELAY && (subscriptions & SUBSCRIBE_RELAY))) {
+            data[0] = event.value & 0xFF;
+            data[1] = event.value >> 8;
+            sendEvent(event.type, data, alarm ? 2 : 1);
+        }
+    }
+
+    byte lost = takeLostEvents();
+    if (lost != 0 && (subscriptions & (SUBSCRIBE_ALARMS | SUBSCRIBE_RELAY))) {
+        sendEvent(EVENT_LOST, &lost, 1);
+    }
+
+    if (subscriptions & (SUBSCRIBE_CLOCK_SECOND | SUBSCRIBE_CLOCK_MINUTE)) {
+        ClockTime now = getClock();
+        bool due = (subscriptions & SUBSCRIBE_CLOCK_SECOND) ? now.second != eventClock.second
+                                                             : now.minute != eventClock.minute;
+        if (due) {
+            eventClock = now;
+            data[0] = now.hour;
+            data[1] = now.minute;
+            data[2] = now.second;
+            sendEvent(EVENT_CLOCK, data, 3);
+        }
     }
 
-    if (passwordSent && !isPasswordCorrect) {
-        lcd.home(); lcd.clear();
-        tone(BUZZER, BUZZER_FREQ, 200);
-        lcd.print(" WRONG PASSWORD ");
-        delay(300); tone(BUZZER, BUZZER_FREQ, 200); delay(MSG_DELAY);
-        if (currentMenu == HOME) initHome(); else displayAlarm();
+    if ((subscriptions & SUBSCRIBE_STATE) && eeprom.state != eventState) {
+        eventState = eeprom.state;
+        sendEvent(EVENT_STATE, &eventState, 1);
     }
 }
 
@@ -368,13 +1203,7 @@ end:
 //   Error Handler
 // ============================================================================
 void handleError() {
-    SerialBT.write(0x01);
-    SerialBT.write(ERROR);
-    SerialBT.flush();
+    sendCode(ERROR);
     FLUSH_REQUEST();
-    lcd.home(); lcd.clear();
-    tone(BUZZER, BUZZER_FREQ, MSG_DELAY);
-    lcd.print("     ERROR!     ");
-    delay(MSG_DELAY);
-    if (currentMenu == HOME) initHome(); else displayAlarm();
+    postMessage("     ERROR!     ", NULL, 0, MSG_DELAY);
 }
@@ -0,0 +1,178 @@
+#include "tasks.h"
+#include "global_vars.h"
+#include "server.h"
+#include <atomic>
+
+// ============================================================================
+//   Global Variables
+// ============================================================================
+TaskHandle_t alarmTaskHandle = NULL;
+TaskHandle_t uiTaskHandle = NULL;
+TaskHandle_t lcdTaskHandle = NULL;
+QueueHandle_t uiQueue = NULL;
+QueueHandle_t eventQueue = NULL;
+std::atomic<uint32_t> lostEvents(0); // Incremented by any task, reset by the protocol task
+SemaphoreHandle_t rtcMutex = NULL;
+
+// ============================================================================
+//   Locks
+//   Before startTasks() setup() is the only user, so locking is skipped.
+// ============================================================================
+void lockRtc() {
+    if (rtcMutex != NULL) xSemaphoreTake(rtcMutex, portMAX_DELAY);
+}
+
+void unlockRtc() {
+    if (rtcMutex != NULL) xSemaphoreGive(rtcMutex);
+}
+
+// ============================================================================
+//   Wake the Alarm Task
+// ============================================================================
+void requestWakeup() {
+    if (alarmTaskHandle != NULL) xTaskNotifyGive(alarmTaskHandle);
+}
+
+// ============================================================================
+//   Wake the LCD Task
+// ============================================================================
+void notifyLcd() {
+    if (lcdTaskHandle != NULL) xTaskNotifyGive(lcdTaskHandle);
+}
+
+// ============================================================================
+//   Wake the UI Task
+// ============================================================================
+void notifyUi() {
+    if (uiTaskHandle != NULL) xTaskNotifyGive(uiTaskHandle);
+}
+
+void IRAM_ATTR notifyUiFromIsr() {
+    if (uiTaskHandle == NULL) return;
+
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(uiTaskHandle, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
+
+// ============================================================================
+//   Queue a Message for the UI Task
+// ============================================================================
+void postMessage(const char *top, const char *bottom, byte chirps, uint16_t toneLength) {
+    UiMessage message;
+    strncpy(message.top, top, sizeof(message.top) - 1);
+    message.top[sizeof(message.top) - 1] = '\0';
+    strncpy(message.bottom, bottom != NULL ? bottom : "", sizeof(message.bottom) - 1);
+    message.bottom[sizeof(message.bottom) - 1] = '\0';
+    message.chirps = chirps;
+    message.toneLength = toneLength;
+
+    xQueueSend(uiQueue, &message, 0);
+    notifyUi();
+}
+
+// ============================================================================
+//   Device Events
+// ============================================================================
+void postEvent(byte type, uint16_t value) {
+    if (eventQueue == NULL) return; // setup(), nobody can be subscribed yet
+
+    Event event = {type, value};
+    if (xQueueSend(eventQueue, &event, 0) != pdTRUE) lostEvents.fetch_add(1);
+}
+
+bool takeEvent(Event &event) {
+    return eventQueue != NULL && xQueueReceive(eventQueue, &event, 0) == pdTRUE;
+}
+
+byte takeLostEvents() {
+    uint32_t lost = lostEvents.exchange(0);
+    return min<uint32_t>(lost, 255);
+}
+
+// ============================================================================
+//   Alarm Task
+//   Owns the RTC reads, the relay and the countdown. Sleeps until the next
+//   due event or until requestWakeup() is called.
+// ============================================================================
+void alarmTask(void *parameter) {
+    while (true) {
+        uint32_t sleep = runScheduler();
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sleep));
+    }
+}
+
+// ============================================================================
+//   UI Task
+//   Owns the screens, the buttons and the buzzer chirps. Sleeps until notified
+//   (button edge, message) or until its next deadline, the next second of the
+//   home screen clock included.
+// ============================================================================
+void uiTask(void *parameter) {
+    UiMessage message;
+
+    while (true) {
+        uint32_t wait = min(min(buttonsTimeLeft(), messageTimeLeft()),
+                            min(min(chirpTimeLeft(), lockTimeLeft()), homeTimeLeft()));
+        ulTaskNotifyTake(pdTRUE, wait == NO_DEADLINE ? portMAX_DELAY : pdMS_TO_TICKS(wait));
+
+        while (xQueueReceive(uiQueue, &message, 0) == pdTRUE) {
+            showMessage(message.top, message.bottom[0] != '\0' ? message.bottom : NULL);
+            if (message.toneLength != 0) tone(BUZZER, BUZZER_FREQ, message.toneLength);
+            if (message.chirps != 0) chirp(message.chirps);
+        }
+
+        readBtns();
+        handleMenu();
+
+        // Redraw the home clock; the flush only sends the cells that changed
+        if (currentMenu == HOME && !isMessageShown()) {
+            serviceClock(); // RTC resync or temperature read, when due
+            refreshHome();
+        }
+
+        serviceMessage();
+        serviceBuzzer();
+    }
+}
+
+// ============================================================================
+//   LCD Task
+//   Only writer of the LCD. Draws the latest frame flushed by the UI task.
+// ============================================================================
+void lcdTask(void *parameter) {
+    while (true) {
+        serviceLcd();
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+// ============================================================================
+//   Protocol Task
+//   Owns the Bluetooth link.
+// ============================================================================
+void protocolTask(void *parameter) {
+    while (true) {
+        execRequest();
+        serviceEvents();
+        vTaskDelay(pdMS_TO_TICKS(PROTOCOL_PERIOD));
+    }
+}
+
+// ============================================================================
+//   Start Tasks
+// ============================================================================
+void startTasks() {
+    rtcMutex = xSemaphoreCreateMutex();
+    uiQueue = xQueueCreate(UI_QUEUE_LENGTH, sizeof(UiMessage));
+    eventQueue = xQueueCreate(EVENT_QUEUE_LENGTH, sizeof(Event));
+
+    xTaskCreatePinnedToCore(alarmTask, "AlarmTask", TASK_STACK_SIZE, NULL,
+                            ALARM_TASK_PRIORITY, &alarmTaskHandle, ALARM_TASK_CORE);
+    xTaskCreatePinnedToCore(uiTask, "UiTask", TASK_STACK_SIZE, NULL,
+                            UI_TASK_PRIORITY, &uiTaskHandle, UI_TASK_CORE);
+    xTaskCreatePinnedToCore(lcdTask, "LcdTask", TASK_STACK_SIZE, NULL,
+                            LCD_TASK_PRIORITY, &lcdTaskHandle, LCD_TASK_CORE);
+    xTaskCreatePinnedToCore(protocolTask, "ProtocolTask", TASK_STACK_SIZE, NULL,
+                            PROTOCOL_TASK_PRIORITY, NULL, PROTOCOL_TASK_CORE);
+}
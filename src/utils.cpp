@@ -1,190 +1,459 @@
 #include "utils.h"
 #include "global_vars.h"
+#include "server.h"
+#include <Wire.h>
 
 // ============================================================================
 //   Global Variables
 // ============================================================================
-byte buttonsPressed; // Stores the state of LOCK, UP, and DOWN buttons
+byte chirpsLeft; // Chirps still to play
+unsigned long nextChirp; // millis() of the next chirp
+bool countdownRunning; // Relay held by a PRGI countdown
+uint32_t countdownStep; // Tick of the next countdown step
+uint32_t wakeupAt; // Tick at which the scheduler was planned to run
+bool wakeupPlanned = false; // wakeupAt is set, cleared until the first run
+uint32_t onsetLatency; // Worst alarm onset latency (ms)
+volatile bool alarmsChanged; // Alarm table edited by the protocol task
+int runningAlarm = NO_ALARM; // Alarm whose PRGI countdown is running
+bool relayOn = false; // Last state written to the relay
+
+ClockTime timeNow, timePrev; // Last two scheduler runs, owned by the alarm task
+ClockTime syncTime; // Last RTC burst and temperature, tick = when it was read
+uint32_t tempTick; // Tick of the last temperature read
+uint16_t secondPhase; // Milliseconds elapsed in the current second of timeNow
+volatile bool clockSynced = false; // Cleared to force an RTC read
+portMUX_TYPE clockMux = portMUX_INITIALIZER_UNLOCKED; // Guards syncTime for getClock()
 
 // ============================================================================
-//   Read Buttons
-//   Checks the state of each button and sets the corresponding bits.
+//   CRC-16/CCITT-FALSE
 // ============================================================================
-void readBtns() {
-    buttonsPressed = 0b000;
-
-    if (digitalRead(LOCK_BTN) == LOW) {
-        delay(DEBOUNCE);
-        bitSet(buttonsPressed, 2); // LOCK button
-    }
-    if (digitalRead(DOWN_BTN) == LOW) {
-        delay(DEBOUNCE);
-        bitSet(buttonsPressed, 1); // DOWN button
-    }
-    if (digitalRead(UP_BTN) == LOW) {
-        delay(DEBOUNCE);
-        bitSet(buttonsPressed, 0); // UP button
+uint16_t crc16(const byte *data, size_t length, uint16_t crc) {
+    while (length--) {
+        crc ^= (uint16_t)*data++ << 8;
+        for (byte bit = 0; bit < 8; bit++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
     }
+    return crc;
+}
+
+// ============================================================================
+//   Buzzer Chirps
+//   Chirps are played by serviceBuzzer() from the UI task instead of delay().
+// ============================================================================
+void chirp(byte count) {
+    chirpsLeft = count;
+    nextChirp = millis();
+    serviceBuzzer();
+}
+
+void serviceBuzzer() {
+    if (chirpsLeft == 0 || (long)(millis() - nextChirp) < 0) return;
+
+    tone(BUZZER, BUZZER_FREQ, CHIRP_LEN);
+    chirpsLeft--;
+    nextChirp += CHIRP_PERIOD;
+}
+
+uint32_t chirpTimeLeft() {
+    if (chirpsLeft == 0) return NO_DEADLINE;
+    long left = nextChirp - millis();
+    return left > 0 ? left : 0;
+}
+
+// ============================================================================
+//   Time Left before the ALARMS Menu Locks
+// ============================================================================
+uint32_t lockTimeLeft() {
+    if (currentMenu != ALARMS) return NO_DEADLINE;
+    unsigned long idle = millis() - lockTime;
+    return idle > LOCK_TIME * 1000UL ? 0 : LOCK_TIME * 1000UL - idle + 1;
+}
+
+// ============================================================================
+//   Alarm Table Edited
+// ============================================================================
+void notifyAlarmsChanged() {
+    alarmsChanged = true;
+    notifyUi();
 }
 
 // ============================================================================
 //   Handle Menu Navigation
 // ============================================================================
 void handleMenu() {
+    // Follow edits of the alarm table made over Bluetooth
+    if (alarmsChanged) {
+        alarmsChanged = false;
+        if (currentMenu == ALARMS) {
+            uint16_t count = scheduledAlarmCount();
+            if (count == 0) {
+                currentMenu = HOME;
+                requestWakeup();
+                if (!isMessageShown()) initHome();
+            } else {
+                if (alarmIndex >= count) alarmIndex = count - 1;
+                if (!isMessageShown()) displayAlarm();
+            }
+        }
+    }
+
+    // Return to HOME menu if ALARMS menu has been idle for too long
+    if (currentMenu == ALARMS && millis() - lockTime > LOCK_TIME * 1000UL) {
+        currentMenu = HOME;
+        requestWakeup();
+        if (!isMessageShown()) initHome();
+    }
+
+    if (isMessageShown()) return; // Buttons are ignored while a message is shown
+
     switch (currentMenu) {
         case HOME:
             if (isPressed(LOCK_BTN)) {
-                tone(BUZZER, 1500, DEBOUNCE);
-                if (eeprom.alarmCount == 0) {
-                    lcd.home();
-                    lcd.clear();
-                    lcd.print("    No alarm    ");
-                    lcd.setCursor(0, 1);
-                    lcd.print("   configured   ");
-                    delay(MSG_DELAY);
-                    initHome();
+                tone(BUZZER, 1500, CLICK_LEN);
+                if (scheduledAlarmCount() == 0) {
+                    showMessage("    No alarm    ", "   configured   ");
                 } else {
                     currentMenu = ALARMS;
                     alarmIndex = 0;
+                    lockTime = millis();
                     displayAlarm();
+                    requestWakeup();
                 }
             }
             break;
 
-        case ALARMS:
-            if (isPressed(LOCK_BTN)) {
-                tone(BUZZER, 1500, DEBOUNCE);
-                lockTime = 0;
+        case ALARMS: {
+            // The protocol task may publish an empty table at any time: read the count once
+            uint16_t count = scheduledAlarmCount();
+            if (isPressed(LOCK_BTN) || count == 0) {
+                if (count != 0) tone(BUZZER, 1500, CLICK_LEN);
                 currentMenu = HOME;
                 initHome();
-                delay(DEBOUNCE);
+                requestWakeup();
+                break;
             }
+            if (alarmIndex >= count) alarmIndex = count - 1; // Shrunk since the last check
             if (isPressed(UP_BTN)) {
-                tone(BUZZER, 1500, DEBOUNCE);
-                lockTime = 0;
-                alarmIndex = (alarmIndex + 1) % eeprom.alarmCount;
+                tone(BUZZER, 1500, CLICK_LEN);
+                lockTime = millis();
+                alarmIndex = (alarmIndex + scrollStep(UP_BTN)) % count;
                 displayAlarm();
-                delay(DEBOUNCE);
             }
             if (isPressed(DOWN_BTN)) {
-                tone(BUZZER, 1500, DEBOUNCE);
-                lockTime = 0;
-                alarmIndex--;
-                if (alarmIndex < 0) alarmIndex = eeprom.alarmCount - 1;
+                tone(BUZZER, 1500, CLICK_LEN);
+                lockTime = millis();
+                alarmIndex -= scrollStep(DOWN_BTN) % count;
+                if (alarmIndex < 0) alarmIndex += count;
                 displayAlarm();
-                delay(DEBOUNCE);
             }
             break;
+        }
     }
 }
 
 // ============================================================================
-//   Check if a Button is Pressed
+//   Burst Read of the DS3231 Time Registers
+//   One I2C transaction for the 7 registers instead of one per field.
 // ============================================================================
-boolean isPressed(uint8_t btn) {
-    if (btn == LOCK_BTN) return bitRead(buttonsPressed, 2);
-    if (btn == DOWN_BTN) return bitRead(buttonsPressed, 1);
-    if (btn == UP_BTN) return bitRead(buttonsPressed, 0);
-    return false;
+static byte bcdToDec(byte value) {
+    return (value >> 4) * 10 + (value & 0x0F);
+}
+
+static byte decToBcd(byte value) {
+    return (value / 10) << 4 | value % 10;
+}
+
+static bool readRtcTime(ClockTime &time) {
+    byte reg[7];
+
+    Wire.beginTransmission(DS3231_ADDRESS);
+    Wire.write(DS3231_TIME_REG);
+    if (Wire.endTransmission() != 0) return false;
+    if (Wire.requestFrom(DS3231_ADDRESS, (uint8_t)7) != 7) return false;
+    for (byte i = 0; i < 7; i++) reg[i] = Wire.read();
+
+    time.second = bcdToDec(reg[0] & 0x7F);
+    time.minute = bcdToDec(reg[1] & 0x7F);
+    h12Flag = reg[2] & 0x40;
+    if (h12Flag) {
+        pmFlag = reg[2] & 0x20;
+        time.hour = bcdToDec(reg[2] & 0x1F);
+    } else {
+        time.hour = bcdToDec(reg[2] & 0x3F);
+    }
+    time.dayOfWeek = reg[3] & 0x07;
+    time.day = bcdToDec(reg[4] & 0x3F);
+    century = reg[5] & 0x80;
+    time.month = bcdToDec(reg[5] & 0x1F);
+    time.year = bcdToDec(reg[6]) + 1970;
+    return true;
 }
 
 // ============================================================================
-//   Update Current Time from RTC
+//   Burst Write of the DS3231 Time Registers
+//   All fields are written in one transaction: the RTC never holds a mix of
+//   the old and new time.
+// ============================================================================
+bool setClock(const ClockTime &time) {
+    lockRtc();
+    Wire.beginTransmission(DS3231_ADDRESS);
+    Wire.write(DS3231_TIME_REG);
+    Wire.write(decToBcd(time.second));
+    Wire.write(decToBcd(time.minute));
+    Wire.write(decToBcd(time.hour)); // Bit 6 cleared: 24-hour mode
+    Wire.write(time.dayOfWeek);
+    Wire.write(decToBcd(time.day));
+    Wire.write(decToBcd(time.month));
+    Wire.write(decToBcd(time.year - 1970));
+    bool ok = Wire.endTransmission() == 0;
+    unlockRtc();
+
+    resyncClock();
+    return ok;
+}
+
+// ============================================================================
+//   Software Clock
+//   → The RTC is read in one burst every RTC_SYNC_PERIOD, when the clock
+//     crosses midnight and after resyncClock(); the temperature on its own
+//     TEMP_PERIOD cadence. Any task may call serviceClock(), the RTC lock
+//     serializes them.
+//   → In between, getClock() advances the last burst by the elapsed ticks,
+//     so no task has to wake up only to keep the time current.
+// ============================================================================
+void resyncClock() {
+    clockSynced = false;
+}
+
+byte daysInMonth(byte month, unsigned int year) {
+    static const byte days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+    if (month < 1 || month > 12) return 31;
+    if (month == 2 && year % 4 == 0 && (year % 100 != 0 || year % 400 == 0)) return 29;
+    return days[month - 1];
+}
+
+// Move `time` forward by `ms`, date included
+static void advanceClock(ClockTime &time, uint32_t ms) {
+    uint32_t secondOfDay = time.hour * 3600UL + time.minute * 60 + time.second + ms / 1000;
+
+    for (; secondOfDay >= 86400UL; secondOfDay -= 86400UL) {
+        time.dayOfWeek = time.dayOfWeek % 7 + 1;
+        if (++time.day > daysInMonth(time.month, time.year)) {
+            time.day = 1;
+            if (++time.month > 12) {
+                time.month = 1;
+                time.year++;
+            }
+        }
+    }
+    time.hour = secondOfDay / 3600;
+    time.minute = secondOfDay / 60 % 60;
+    time.second = secondOfDay % 60;
+    time.tick += ms - ms % 1000; // Start of time.second
+}
+
+static ClockTime clockAt(uint32_t now) {
+    portENTER_CRITICAL(&clockMux);
+    ClockTime time = syncTime;
+    portEXIT_CRITICAL(&clockMux);
+
+    if (!h12Flag) advanceClock(time, now - time.tick); // 12-hour mode: read every time, not extrapolated
+    return time;
+}
+
+void serviceClock() {
+    lockRtc();
+    uint32_t now = ticks;
+    ClockTime time = syncTime; // Only written with the RTC lock held
+    uint32_t elapsed = now - time.tick;
+    uint32_t secondOfDay = time.hour * 3600UL + time.minute * 60 + time.second + elapsed / 1000;
+
+    if (!clockSynced || elapsed >= RTC_SYNC_PERIOD * 1000UL || secondOfDay >= 86400UL || h12Flag) {
+        if (readRtcTime(time)) { // On failure keep counting from the last burst, retry next time
+            time.tick = now;
+            clockSynced = true;
+        }
+    }
+
+    if (tempTick == 0 || now - tempTick >= TEMP_PERIOD * 1000UL) {
+        time.temperature = (byte)roundf(myRTC.getTemperature());
+        tempTick = now | 1; // Never 0 once read
+    }
+
+    portENTER_CRITICAL(&clockMux);
+    syncTime = time;
+    portEXIT_CRITICAL(&clockMux);
+    unlockRtc();
+}
+
+ClockTime getClock() {
+    return clockAt(ticks);
+}
+
+// ============================================================================
+//   Update Current Time
+//   Time seen by one run of the scheduler.
 // ============================================================================
 void updateTime() {
-    // Save previous time values
-    prevHour = hourNow; prevMinute = minuteNow; prevSecond = secondNow;
-    prevDay = dayNow; prevMonth = monthNow; prevYear = yearNow;
-    prevTemperature = temperatureNow; prevDayOfWeek = dayOfWeekNow;
+    serviceClock();
 
-    // Read current time from DS3231 RTC
-    hourNow = myRTC.getHour(h12Flag, pmFlag);
-    minuteNow = myRTC.getMinute();
-    secondNow = myRTC.getSecond();
-    dayNow = myRTC.getDate();
-    monthNow = myRTC.getMonth(century);
-    yearNow = myRTC.getYear() + 1970;
-    temperatureNow = (byte)roundf(myRTC.getTemperature());
-    dayOfWeekNow = myRTC.getDoW();
+    uint32_t now = ticks;
+    timePrev = timeNow;
+    timeNow = clockAt(now);
+    secondPhase = now - timeNow.tick;
+}
+
+// ============================================================================
+//   Relay
+//   Active low. Transitions are reported to subscribed clients.
+// ============================================================================
+static void setRelay(bool on) {
+    digitalWrite(RELAY, on ? LOW : HIGH);
+    if (on != relayOn) {
+        relayOn = on;
+        postEvent(EVENT_RELAY, on);
+    }
 }
 
 // ============================================================================
 //   Check and Trigger Alarms
 // ============================================================================
-void checkAndTriggerAlarm() {
-    for (byte i = 0; i < eeprom.alarmCount; i++) {
-        if (bitRead(eeprom.alarms[i].days, 0) &&       // Alarm active
-            eeprom.alarms[i].hour == hourNow &&            // Hour matches
-            eeprom.alarms[i].minute == minuteNow &&          // Minute matches
-            bitRead(eeprom.alarms[i].days, 8 - dayOfWeekNow)) // Day matches
-        {
-            if (eeprom.programType == 0) {
-                duration = eeprom.alarms[i].duration; // Retrieve duration
-            } else {
-                digitalWrite(RELAY, eeprom.alarms[i].duration == 0 ? HIGH : LOW);
-                digitalWrite(LED, eeprom.alarms[i].duration == 0 ? LOW : HIGH);
-            }
-            break;
+bool checkAndTriggerAlarm() {
+    const Schedule *table = acquireSchedule();
+
+    int i = scheduledAlarm(*table, minuteOfWeek(timeNow.dayOfWeek, timeNow.hour, timeNow.minute));
+    if (i != NO_ALARM) {
+        postEvent(EVENT_ALARM_FIRED, i);
+        if (table->programType == 0) {
+            setDuration(alarmDuration(table->alarms[i])); // Retrieve duration
+            runningAlarm = i;
+        } else {
+            setRelay(alarmDuration(table->alarms[i]) != 0);
+            digitalWrite(LED, alarmDuration(table->alarms[i]) == 0 ? LOW : HIGH);
         }
     }
+
+    releaseSchedule(table);
+    return i != NO_ALARM;
 }
 
 // ============================================================================
 //   Initialize Relay based on previous Alarm
 // ============================================================================
 void initRelay() {
-    if (eeprom.alarmCount == 0) return;
+    const Schedule *table = acquireSchedule();
+    if (table->alarmCount == 0) {
+        releaseSchedule(table);
+        return;
+    }
 
-    int minutes = hourNow * 60 + minuteNow;
+    int minutes = timeNow.hour * 60 + timeNow.minute;
     int idx = 0;
 
-    while (minutes < eeprom.alarms[idx].hour * 60 + eeprom.alarms[idx].minute &&
-           idx < eeprom.alarmCount) {
+    while (minutes < alarmMinuteOfDay(table->alarms[idx]) &&
+           idx < table->alarmCount) {
         idx++;
     }
     idx--;
-    if (idx < 0) idx = eeprom.alarmCount - 1;
+    if (idx < 0) idx = table->alarmCount - 1;
 
-    if (bitRead(eeprom.alarms[idx].days, 0)) {
-        digitalWrite(RELAY, eeprom.alarms[idx].duration == 0 ? HIGH : LOW);
-        digitalWrite(LED, eeprom.alarms[idx].duration == 0 ? LOW : HIGH);
+    if (alarmActive(table->alarms[idx])) {
+        setRelay(alarmDuration(table->alarms[idx]) != 0);
+        digitalWrite(LED, alarmDuration(table->alarms[idx]) == 0 ? LOW : HIGH);
     }
+    releaseSchedule(table);
 }
 
 // ============================================================================
-//   Tasks to Execute Every Second
+//   Time to the Next Alarm Start (ms), MAX_SLEEP if none
 // ============================================================================
-void everySecond() {
+static uint32_t nextAlarmIn() {
+    // The current minute has already been checked by this run
+    uint16_t now = minuteOfWeek(timeNow.dayOfWeek, timeNow.hour, timeNow.minute);
+
+    const Schedule *table = acquireSchedule();
+    uint16_t next = table->state ? nextEventMinute(*table, (now + 1) % MINUTES_PER_WEEK) : MINUTES_PER_WEEK;
+    releaseSchedule(table);
+    if (next == MINUTES_PER_WEEK) return MAX_SLEEP;
+
+    uint32_t minutes = (next + MINUTES_PER_WEEK - now) % MINUTES_PER_WEEK;
+    if (minutes == 0) minutes = MINUTES_PER_WEEK;
+
+    return min<uint32_t>((minutes * 60 - timeNow.second) * 1000UL - secondPhase, MAX_SLEEP);
+}
+
+// ============================================================================
+//   Scheduler
+//   Runs the due events, then returns how long the alarm task may sleep:
+//   until the next alarm start or countdown step, MAX_SLEEP at most. The
+//   clock shown on the LCD is refreshed by the UI task on its own timer.
+//   Waking up early is harmless: nothing is due and the delay is recomputed.
+// ============================================================================
+uint32_t runScheduler() {
+    uint32_t now = ticks;
+    if (wakeupPlanned && (int32_t)(now - wakeupAt) > 0) {
+        missedTicks += (now - wakeupAt) / 1000; // Whole seconds the task ran late by
+    }
+
     updateTime();
 
-    // Trigger alarm if minute has changed and program is active
-    if (minuteNow != prevMinute && eeprom.state) {
-        checkAndTriggerAlarm();
+    // Trigger alarm if the minute has changed and program is active. Runs can
+    // be an hour apart, so the whole minute of the week is compared.
+    uint16_t minute = minuteOfWeek(timeNow.dayOfWeek, timeNow.hour, timeNow.minute);
+    if (minute != minuteOfWeek(timePrev.dayOfWeek, timePrev.hour, timePrev.minute) && scheduledState()) {
+        if (checkAndTriggerAlarm()) {
+            // Long stalls are the ones worth reporting: every latency is kept,
+            // an early wakeup (requestWakeup()) counts as none
+            int32_t late = ticks - wakeupAt;
+            uint32_t latency = late > 0 ? late : 0;
+            if (wakeupPlanned && latency > onsetLatency) onsetLatency = latency;
+        }
     }
 
     // Handle numeric program type alarms
-    if (eeprom.programType == 0) {
-        if (duration == 0) {
-            digitalWrite(RELAY, HIGH);
-        } else {
-            digitalWrite(RELAY, LOW);
-            duration--;
+    // Steps are tied to ticks, so seconds lost while the task was delayed are caught up
+    if (scheduledProgramType() == 0) {
+        if (duration > 0 && !countdownRunning) {
+            countdownRunning = true;
+            countdownStep = now;
+        }
+        while (countdownRunning && (int32_t)(now - countdownStep) >= 0) {
+            if (duration == 0) {
+                countdownRunning = false;
+                if (runningAlarm != NO_ALARM) postEvent(EVENT_ALARM_ENDED, runningAlarm);
+                runningAlarm = NO_ALARM;
+                break;
+            }
+            setDuration(duration - 1);
+            countdownStep += 1000;
+        }
+        if (countdownRunning) {
+            setRelay(true);
             tone(BUZZER, BUZZER_FREQ, 300);
+        } else {
+            setRelay(false);
         }
     }
 
-    // Refresh display
-    if (currentMenu == HOME) {
-        refreshHome();
-    }
+    // -------------------------
+    // Next due event
+    // -------------------------
+    uint32_t sleep = nextAlarmIn();
 
-    // Return to HOME menu if ALARMS menu has been idle for too long
-    if (currentMenu == ALARMS) {
-        lockTime++;
-        if (lockTime > LOCK_TIME) {
-            currentMenu = HOME;
-            lockTime = 0;
-            initHome();
-        }
+    if (countdownRunning) {
+        sleep = min<uint32_t>(sleep, countdownStep - now);
     }
+
+    wakeupAt = now + sleep;
+    wakeupPlanned = true;
+    return sleep;
+}
+
+// ============================================================================
+//   Worst Alarm Onset Latency
+// ============================================================================
+uint32_t getOnsetLatency() {
+    return onsetLatency;
 }
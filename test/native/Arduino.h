@@ -0,0 +1,326 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// ============================================================================
+//   Host Stand-in for the ESP32 Arduino Core
+//   Just enough of the core for the firmware to build and run natively
+//   ([env:native]):
+//   → Time is the firmware tick counter: millis() reads `ticks`, and the
+//     tests move time by moving it (or by calling the 7-segment ISR).
+//   → GPIO and the W1TS/W1TC registers are simulated and count accesses.
+//   → FreeRTOS objects are in-memory structures. Tasks are created but
+//     never run: the tests call the functions the tasks loop on.
+// ============================================================================
+
+// Standard headers first: the firmware defines pin macros named A to D
+#include <algorithm>
+#include <map>
+#include <math.h>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define IRAM_ATTR
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+
+// Binary constants of binary.h used by the firmware (5-bit LCD glyph rows)
+#define B00000 0
+#define B00001 1
+#define B00010 2
+#define B00011 3
+#define B00100 4
+#define B00101 5
+#define B00110 6
+#define B00111 7
+#define B01000 8
+#define B01001 9
+#define B01010 10
+#define B01011 11
+#define B01100 12
+#define B01101 13
+#define B01110 14
+#define B01111 15
+#define B10000 16
+#define B10001 17
+#define B10010 18
+#define B10011 19
+#define B10100 20
+#define B10101 21
+#define B10110 22
+#define B10111 23
+#define B11000 24
+#define B11001 25
+#define B11010 26
+#define B11011 27
+#define B11100 28
+#define B11101 29
+#define B11110 30
+#define B11111 31
+
+// ============================================================================
+//   Time
+// ============================================================================
+
+// Milliseconds counted by the 7-segment ISR, defined in main.cpp
+extern volatile uint32_t ticks;
+
+inline unsigned long millis() { return ticks; }
+inline unsigned long micros() { return ticks * 1000UL; }
+inline void delay(uint32_t ms) { ticks = ticks + ms; }
+inline void delayMicroseconds(uint32_t us) {}
+
+// ============================================================================
+//   Simulated GPIO
+//   GPIO 0-31 only, which covers every pin of the board.
+// ============================================================================
+#define GPIO_OUT_REG      0x3FF44004
+#define GPIO_OUT_W1TS_REG 0x3FF44008
+#define GPIO_OUT_W1TC_REG 0x3FF4400C
+#define GPIO_IN_REG       0x3FF4403C
+
+struct MockGpio {
+    uint32_t out;               // Output levels
+    uint32_t in = 0xFFFFFFFF;   // Input levels, pulled up: released buttons read HIGH
+    uint32_t regWrites;         // REG_WRITE calls
+    uint32_t regReads;          // REG_READ calls
+    uint32_t pinWrites;         // digitalWrite calls
+    uint32_t pinReads;          // digitalRead calls
+    void (*isr[32])();          // attachInterrupt handlers, by pin
+};
+inline MockGpio mockGpio;
+
+inline void mockRegWrite(uint32_t reg, uint32_t value) {
+    mockGpio.regWrites++;
+    if (reg == GPIO_OUT_W1TS_REG) mockGpio.out |= value;
+    else if (reg == GPIO_OUT_W1TC_REG) mockGpio.out &= ~value;
+    else if (reg == GPIO_OUT_REG) mockGpio.out = value;
+}
+
+inline uint32_t mockRegRead(uint32_t reg) {
+    mockGpio.regReads++;
+    if (reg == GPIO_IN_REG) return mockGpio.in;
+    return reg == GPIO_OUT_REG ? mockGpio.out : 0;
+}
+
+#define REG_WRITE(reg, value) mockRegWrite((reg), (value))
+#define REG_READ(reg) mockRegRead(reg)
+
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+
+inline void digitalWrite(uint8_t pin, uint8_t level) {
+    mockGpio.pinWrites++;
+    if (level) mockGpio.out |= 1UL << pin;
+    else mockGpio.out &= ~(1UL << pin);
+}
+
+inline int digitalRead(uint8_t pin) {
+    mockGpio.pinReads++;
+    return (mockGpio.in >> pin) & 1;
+}
+
+#define digitalPinToInterrupt(pin) (pin)
+
+inline void attachInterrupt(uint8_t pin, void (*handler)(), int mode) {
+    mockGpio.isr[pin] = handler;
+}
+
+// Drive an input pin and run its interrupt, as a button edge would
+inline void mockPinEdge(uint8_t pin, uint8_t level) {
+    if (level) mockGpio.in |= 1UL << pin;
+    else mockGpio.in &= ~(1UL << pin);
+    if (mockGpio.isr[pin] != NULL) mockGpio.isr[pin]();
+}
+
+// ============================================================================
+//   Buzzer
+// ============================================================================
+struct MockTone {
+    uint32_t count;             // tone() calls
+    unsigned int frequency;     // Last tone
+    unsigned long duration;
+    uint32_t tick;              // Tick of the last tone
+};
+inline MockTone mockTone;
+
+inline void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0) {
+    mockTone.count++;
+    mockTone.frequency = frequency;
+    mockTone.duration = duration;
+    mockTone.tick = ticks;
+}
+
+// ============================================================================
+//   Hardware Timer
+//   The tests call the 7-segment ISR themselves.
+// ============================================================================
+struct hw_timer_s {};
+typedef struct hw_timer_s hw_timer_t;
+inline hw_timer_t mockTimer;
+
+inline hw_timer_t *timerBegin(uint8_t num, uint16_t divider, bool countUp) { return &mockTimer; }
+inline void timerAttachInterrupt(hw_timer_t *timer, void (*handler)(), bool edge) {}
+inline void timerAlarmWrite(hw_timer_t *timer, uint64_t value, bool reload) {}
+inline void timerAlarmEnable(hw_timer_t *timer) {}
+
+// ============================================================================
+//   Random Numbers
+// ============================================================================
+inline uint32_t esp_random() {
+    return (uint32_t)rand() << 16 ^ (uint32_t)rand();
+}
+
+inline void esp_fill_random(void *buffer, size_t length) {
+    for (size_t i = 0; i < length; i++) ((byte *)buffer)[i] = esp_random();
+}
+
+// ============================================================================
+//   FreeRTOS
+// ============================================================================
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define portMAX_DELAY 0xFFFFFFFF
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portYIELD_FROM_ISR()
+
+struct MockTask {
+    const char *name;
+    uint32_t notifications;     // xTaskNotifyGive() calls not taken yet
+};
+typedef MockTask *TaskHandle_t;
+
+inline BaseType_t xTaskCreatePinnedToCore(void (*code)(void *), const char *name, uint32_t stackSize,
+                                          void *parameter, UBaseType_t priority, TaskHandle_t *handle,
+                                          BaseType_t core) {
+    TaskHandle_t task = new MockTask{name, 0};
+    if (handle != NULL) *handle = task;
+    return pdPASS;
+}
+
+inline void vTaskDelete(TaskHandle_t task) {}
+
+// Other threads of a test may hold what the caller waits for
+inline void vTaskDelay(TickType_t delay) { std::this_thread::yield(); }
+
+inline void xTaskNotifyGive(TaskHandle_t task) { task->notifications++; }
+
+inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) {
+    task->notifications++;
+    *woken = pdTRUE;
+}
+
+// Tasks never run, so no task waits here
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait) { return 0; }
+
+struct MockQueue {
+    std::vector<byte> items;
+    size_t itemSize;
+    size_t length;
+    size_t head;                // Oldest item
+    size_t count;
+};
+typedef MockQueue *QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    return new MockQueue{std::vector<byte>(length * itemSize), itemSize, length, 0, 0};
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait) {
+    if (queue->count == queue->length) return pdFALSE;
+    size_t slot = (queue->head + queue->count++) % queue->length;
+    memcpy(&queue->items[slot * queue->itemSize], item, queue->itemSize);
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait) {
+    if (queue->count == 0) return pdFALSE;
+    memcpy(item, &queue->items[queue->head * queue->itemSize], queue->itemSize);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    return pdTRUE;
+}
+
+typedef std::mutex *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new std::mutex; }
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t wait) {
+    mutex->lock();
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+    mutex->unlock();
+    return pdTRUE;
+}
+
+// Critical sections only guard against the ISR and the other core, which
+// the host does not have
+typedef struct {
+    uint32_t owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) (void)(mux)
+#define portEXIT_CRITICAL(mux) (void)(mux)
+
+// ============================================================================
+//   Print and Stream
+// ============================================================================
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        size_t n = 0;
+        while (size--) n += write(*buffer++);
+        return n;
+    }
+    size_t write(const char *text) { return write((const uint8_t *)text, strlen(text)); }
+    size_t print(const char *text) { return write(text); }
+    virtual void flush() {}
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    size_t readBytes(uint8_t *buffer, size_t length) {
+        size_t n = 0;
+        for (int c; n < length && (c = read()) >= 0;) buffer[n++] = c;
+        return n;
+    }
+};
+
+#endif
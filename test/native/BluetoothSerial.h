@@ -0,0 +1,20 @@
+#ifndef BLUETOOTH_SERIAL_H
+#define BLUETOOTH_SERIAL_H
+
+#include <Arduino.h>
+
+// ============================================================================
+//   Host Stand-in for BluetoothSerial
+//   Never has a client: the tests attach their own transports.
+// ============================================================================
+class BluetoothSerial : public Stream {
+  public:
+    bool begin(const char *name) { return true; }
+    bool hasClient() { return false; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    size_t write(uint8_t c) override { return 1; }
+    using Print::write;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef DS3231_H
+#define DS3231_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// ============================================================================
+//   Host Stand-in for the DS3231 Library
+//   Same register accesses as the library, on the virtual bus of Wire.h.
+// ============================================================================
+class DS3231 {
+  public:
+    float getTemperature() {
+        byte msb, lsb;
+        Wire.beginTransmission(VIRTUAL_DS3231_ADDRESS);
+        Wire.write(0x11);
+        Wire.endTransmission();
+        Wire.requestFrom(VIRTUAL_DS3231_ADDRESS, 2);
+        msb = Wire.read();
+        lsb = Wire.read();
+        return (int8_t)msb + (lsb >> 6) * 0.25f;
+    }
+
+    void setSecond(byte second) { writeRegister(0x00, bcd(second)); }
+    void setMinute(byte minute) { writeRegister(0x01, bcd(minute)); }
+    void setHour(byte hour) { writeRegister(0x02, bcd(hour)); } // 24-hour mode
+    void setDoW(byte dayOfWeek) { writeRegister(0x03, dayOfWeek); }
+    void setDate(byte date) { writeRegister(0x04, bcd(date)); }
+    void setMonth(byte month) { writeRegister(0x05, bcd(month)); }
+    void setYear(byte year) { writeRegister(0x06, bcd(year)); }
+
+  private:
+    static byte bcd(byte value) { return (value / 10) << 4 | value % 10; }
+
+    static void writeRegister(byte reg, byte value) {
+        Wire.beginTransmission(VIRTUAL_DS3231_ADDRESS);
+        Wire.write(reg);
+        Wire.write(value);
+        Wire.endTransmission();
+    }
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef LIQUID_CRYSTAL_H
+#define LIQUID_CRYSTAL_H
+
+#include <Arduino.h>
+
+// ============================================================================
+//   Virtual HD44780
+//   Host stand-in for LiquidCrystal that emulates the controller behind it:
+//   → DDRAM: 80 bytes, rows at 0x00 and 0x40 in 2-line mode, 40 per row
+//   → CGRAM: 8 characters of 8 rows; codes 8-15 show the same characters
+//   → One address counter for both: after createChar() data goes to CGRAM
+//     until a DDRAM address is set (setCursor, home or clear)
+//   Each transaction (instruction or data byte) is counted and costs what
+//   the Arduino library blocks for: two 4-bit transfers, each an enable
+//   pulse and a 100 µs settle, plus 2 ms after clear and home.
+//   onTransaction, if set, runs after each one: a test can make the LCD
+//   slow or act while a frame is being drawn.
+// ============================================================================
+#define HD44780_TRANSFER_US 204     // Two nibbles of 1 + 1 + 100 µs (LiquidCrystal::pulseEnable)
+#define HD44780_CLEAR_US 2000       // Wait after clear() and home()
+
+#define HD44780_ROW_LENGTH 40       // DDRAM cells per row in 2-line mode
+#define HD44780_ROW2_ADDRESS 0x40
+
+class LiquidCrystal : public Print {
+  public:
+    uint32_t commands = 0;          // Instructions sent
+    uint32_t dataWrites = 0;        // Data bytes sent (characters, CGRAM rows)
+    uint32_t busMicros = 0;         // Time the library blocked on the bus (µs)
+    void (*onTransaction)() = NULL; // Called after each transaction
+
+    LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7) {
+        memset(ddram, ' ', sizeof(ddram));
+    }
+
+    // Function set, display on, clear, entry mode left to right
+    void begin(uint8_t cols, uint8_t rows) {
+        lines = rows;
+        command();
+        command();
+        clear();
+        command();
+    }
+
+    void clear() {
+        memset(ddram, ' ', sizeof(ddram));
+        setAddress(false, 0);
+        busMicros += HD44780_CLEAR_US;
+    }
+
+    void home() {
+        setAddress(false, 0);
+        busMicros += HD44780_CLEAR_US;
+    }
+
+    // Row clamped to the number of lines, as the library does
+    void setCursor(uint8_t col, uint8_t row) {
+        if (row >= lines) row = lines - 1;
+        setAddress(false, col + (row == 0 ? 0 : HD44780_ROW2_ADDRESS));
+    }
+
+    void createChar(uint8_t location, uint8_t charmap[]) {
+        setAddress(true, (location & 0x07) << 3);
+        for (byte i = 0; i < 8; i++) write(charmap[i]);
+    }
+
+    size_t write(uint8_t c) override {
+        if (cgramMode) {
+            cgram[address & 0x3F] = c & 0x1F;
+            address = (address + 1) & 0x3F;
+        } else {
+            ddram[ddramIndex(address)] = c;
+            address = nextDdramAddress(address);
+        }
+        transaction(false);
+        return 1;
+    }
+    using Print::write;
+
+    uint32_t transactions() const { return commands + dataWrites; }
+
+    // ------------------------------------------------------------------------
+    //   Inspection
+    // ------------------------------------------------------------------------
+
+    // Character code shown at a cell of the 16x2 window
+    byte at(byte col, byte row) const {
+        return ddram[row * HD44780_ROW_LENGTH + col];
+    }
+
+    // Pattern of a character code, NULL if it is not a CGRAM character
+    const byte *glyph(byte code) const {
+        return code < 16 ? cgram + (code & 0x07) * 8 : NULL;
+    }
+
+    bool addressingCgram() const { return cgramMode; }
+
+  private:
+    byte ddram[2 * HD44780_ROW_LENGTH];
+    byte cgram[64] = {};
+    byte address = 0;               // Address counter
+    bool cgramMode = false;         // The counter points into CGRAM
+    byte lines = 2;
+
+    static byte ddramIndex(byte address) {
+        byte row = address >= HD44780_ROW2_ADDRESS;
+        byte col = (address - row * HD44780_ROW2_ADDRESS) % HD44780_ROW_LENGTH;
+        return row * HD44780_ROW_LENGTH + col;
+    }
+
+    // The end of the first row continues on the second, and back
+    static byte nextDdramAddress(byte address) {
+        if (address == HD44780_ROW_LENGTH - 1) return HD44780_ROW2_ADDRESS;
+        if (address == HD44780_ROW2_ADDRESS + HD44780_ROW_LENGTH - 1) return 0;
+        return address + 1;
+    }
+
+    void setAddress(bool toCgram, byte value) {
+        cgramMode = toCgram;
+        address = value;
+        command();
+    }
+
+    void command() { transaction(true); }
+
+    void transaction(bool instruction) {
+        if (instruction) commands++;
+        else dataWrites++;
+        busMicros += HD44780_TRANSFER_US;
+        if (onTransaction != NULL) onTransaction();
+    }
+};
+
+#endif
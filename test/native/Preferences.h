@@ -0,0 +1,80 @@
+#ifndef PREFERENCES_H
+#define PREFERENCES_H
+
+#include <Arduino.h>
+
+// ============================================================================
+//   Host Stand-in for Preferences (NVS)
+//   The keys live in mockNvs, which outlives begin()/end() as the flash
+//   does. Key operations are counted; writes can be made to fail, from
+//   the start or after a number of them (a power cut).
+// ============================================================================
+struct MockNvs {
+    std::map<std::string, std::vector<byte>> keys;
+    uint32_t reads;                 // getBytes(), getInt() and isKey() calls
+    uint32_t writes;                // putBytes() and putInt() calls
+    uint32_t removes;               // remove() calls
+    size_t bytesWritten;
+    int writesLeft = -1;            // Writes that succeed before all fail, -1 for no limit
+
+    void clear() { *this = MockNvs(); }
+};
+inline MockNvs mockNvs;
+
+class Preferences {
+  public:
+    // Fails if already started, as the library does
+    bool begin(const char *name, bool readOnly = false) {
+        if (started) return false;
+        started = true;
+        return true;
+    }
+
+    void end() { started = false; }
+
+    bool isStarted() const { return started; }
+
+    size_t getBytes(const char *key, void *buffer, size_t maxLength) {
+        if (!started) return 0;
+        mockNvs.reads++;
+        auto it = mockNvs.keys.find(key);
+        if (it == mockNvs.keys.end() || it->second.size() > maxLength) return 0;
+        memcpy(buffer, it->second.data(), it->second.size());
+        return it->second.size();
+    }
+
+    size_t putBytes(const char *key, const void *value, size_t length) {
+        if (!started || mockNvs.writesLeft == 0) return 0;
+        if (mockNvs.writesLeft > 0) mockNvs.writesLeft--;
+        mockNvs.writes++;
+        mockNvs.bytesWritten += length;
+        mockNvs.keys[key].assign((const byte *)value, (const byte *)value + length);
+        return length;
+    }
+
+    int32_t getInt(const char *key, int32_t defaultValue = 0) {
+        int32_t value;
+        return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+    }
+
+    size_t putInt(const char *key, int32_t value) {
+        return putBytes(key, &value, sizeof(value));
+    }
+
+    bool isKey(const char *key) {
+        if (!started) return false;
+        mockNvs.reads++;
+        return mockNvs.keys.count(key) != 0;
+    }
+
+    bool remove(const char *key) {
+        if (!started) return false;
+        mockNvs.removes++;
+        return mockNvs.keys.erase(key) != 0;
+    }
+
+  private:
+    bool started = false;
+};
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <Arduino.h>
+
+// ============================================================================
+//   Host Stand-in for the Wire (I2C) Library
+//   The bus holds one device, a virtual DS3231 at 0x68 whose clock follows
+//   the firmware tick counter. Transactions are counted, so a test can
+//   check what each firmware path costs on the bus.
+// ============================================================================
+#define VIRTUAL_DS3231_ADDRESS 0x68
+
+// ============================================================================
+//   Virtual DS3231
+//   Registers as the firmware reads them: BCD time in 24-hour mode, day of
+//   week 1-7 advanced at midnight, year register = year - 1970. Writing a
+//   time register restarts the second, as on the chip.
+// ============================================================================
+class VirtualDs3231 {
+  public:
+    float temperature = 21.25f;     // Returned by the temperature registers
+    byte pointer;                   // Register pointer
+
+    // Set the clock at the current tick. dayOfWeek: 1 = Sun ... 7 = Sat
+    void set(unsigned int year, byte month, byte day, byte dayOfWeek, byte hour, byte minute, byte second) {
+        seconds = (int64_t)daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+        baseDayOfWeek = dayOfWeek;
+        baseTick = ticks;
+    }
+
+    // Seconds since 1970-01-01 00:00:00 at the current tick
+    int64_t now() const { return seconds + (uint32_t)(ticks - baseTick) / 1000; }
+
+    byte dayOfWeek() const {
+        int64_t days = now() / 86400 - seconds / 86400;
+        return (baseDayOfWeek - 1 + days) % 7 + 1;
+    }
+
+    void date(unsigned int &year, byte &month, byte &day) const {
+        civilFromDays(now() / 86400, year, month, day);
+    }
+
+    byte readRegister(byte reg) const {
+        int64_t t = now();
+        unsigned int year;
+        byte month, day;
+        civilFromDays(t / 86400, year, month, day);
+
+        switch (reg) {
+            case 0x00: return bcd(t % 60);
+            case 0x01: return bcd(t / 60 % 60);
+            case 0x02: return bcd(t / 3600 % 24);
+            case 0x03: return dayOfWeek();
+            case 0x04: return bcd(day);
+            case 0x05: return bcd(month);
+            case 0x06: return bcd(year - 1970);
+            case 0x11: return (int8_t)floorf(temperature);
+            case 0x12: return (byte)((temperature - floorf(temperature)) * 4) << 6;
+            default: return 0;
+        }
+    }
+
+    void writeRegister(byte reg, byte value) {
+        writeRegisters(reg, &value, 1);
+    }
+
+    // A burst write lands at once: the date is only checked once all its
+    // registers hold their new value, as the chip never normalizes them
+    void writeRegisters(byte reg, const byte *values, byte count) {
+        int64_t t = now();
+        unsigned int year;
+        byte month, day;
+        civilFromDays(t / 86400, year, month, day);
+        byte dow = dayOfWeek();
+        byte hour = t / 3600 % 24, minute = t / 60 % 60, second = t % 60;
+        bool changed = false;
+
+        for (byte i = 0; i < count; i++, reg++) {
+            byte value = values[i];
+            switch (reg) {
+                case 0x00: second = decimal(value & 0x7F); break;
+                case 0x01: minute = decimal(value & 0x7F); break;
+                case 0x02: hour = decimal(value & 0x3F); break;
+                case 0x03: dow = value & 0x07; break;
+                case 0x04: day = decimal(value & 0x3F); break;
+                case 0x05: month = decimal(value & 0x1F); break;
+                case 0x06: year = decimal(value) + 1970; break;
+                default: continue;
+            }
+            changed = true;
+        }
+        if (changed) set(year, month, day, dow, hour, minute, second);
+    }
+
+  private:
+    int64_t seconds;                // Time at baseTick
+    byte baseDayOfWeek = 1;         // Day of week at baseTick
+    uint32_t baseTick;
+
+    static byte bcd(unsigned int value) { return (value / 10) << 4 | value % 10; }
+    static byte decimal(byte value) { return (value >> 4) * 10 + (value & 0x0F); }
+
+    // Days since 1970-01-01 of a civil date, and back (proleptic Gregorian)
+    static int64_t daysFromCivil(int year, unsigned int month, unsigned int day) {
+        year -= month <= 2;
+        int64_t era = (year >= 0 ? year : year - 399) / 400;
+        unsigned int yoe = year - era * 400;
+        unsigned int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        unsigned int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + doe - 719468;
+    }
+
+    static void civilFromDays(int64_t days, unsigned int &year, byte &month, byte &day) {
+        days += 719468;
+        int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+        unsigned int doe = days - era * 146097;
+        unsigned int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        unsigned int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        unsigned int mp = (5 * doy + 2) / 153;
+        day = doy - (153 * mp + 2) / 5 + 1;
+        month = mp < 10 ? mp + 3 : mp - 9;
+        year = yoe + era * 400 + (month <= 2);
+    }
+};
+
+// ============================================================================
+//   TwoWire
+// ============================================================================
+class TwoWire {
+  public:
+    VirtualDs3231 rtc;
+    uint32_t transactions;          // endTransmission() and requestFrom() calls
+    bool failing;                   // The device does not acknowledge
+
+    void begin() {}
+
+    void beginTransmission(int address) {
+        target = address;
+        txLength = 0;
+    }
+
+    size_t write(uint8_t data) {
+        if (txLength >= sizeof(txBuffer)) return 0;
+        txBuffer[txLength++] = data;
+        return 1;
+    }
+
+    // First byte sets the register pointer, the next ones are written from it
+    uint8_t endTransmission(bool stop = true) {
+        transactions++;
+        if (target != VIRTUAL_DS3231_ADDRESS || failing) return 2; // Address NACK
+        if (txLength > 0) rtc.pointer = txBuffer[0];
+        if (txLength > 1) rtc.writeRegisters(rtc.pointer, txBuffer + 1, txLength - 1);
+        rtc.pointer += txLength > 1 ? txLength - 1 : 0;
+        return 0;
+    }
+
+    uint8_t requestFrom(int address, int quantity) {
+        transactions++;
+        rxLength = rxIndex = 0;
+        if (address != VIRTUAL_DS3231_ADDRESS || failing) return 0;
+        while (rxLength < quantity && rxLength < sizeof(rxBuffer)) rxBuffer[rxLength++] = rtc.readRegister(rtc.pointer++);
+        return rxLength;
+    }
+
+    int available() { return rxLength - rxIndex; }
+    int read() { return rxIndex < rxLength ? rxBuffer[rxIndex++] : -1; }
+
+  private:
+    int target;
+    byte txBuffer[32];
+    byte txLength;
+    byte rxBuffer[32];
+    byte rxLength;
+    byte rxIndex;
+};
+
+inline TwoWire Wire;
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef FD_TRANSPORT_H
+#define FD_TRANSPORT_H
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "transport.h"
+
+// ============================================================================
+//   File Descriptor Transport
+//   Host backend of the protocol engine over a Linux file descriptor: a
+//   socket (TCP or socketpair) or the master side of a pty, whose slave
+//   path any serial client can open. Non-blocking; connected until the
+//   peer hangs up and everything it sent was read.
+// ============================================================================
+class FdTransport : public Transport {
+  public:
+    // Serve `fd`, or nothing with -1
+    void attach(int descriptor) {
+        fd = descriptor;
+        if (fd >= 0) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    bool connected() override {
+        if (fd < 0) return false;
+        struct pollfd p = {fd, POLLIN, 0};
+        if (poll(&p, 1, 0) < 0) return false;
+        return !(p.revents & (POLLHUP | POLLERR)) || available() > 0;
+    }
+
+    int available() override {
+        int n = 0;
+        return ioctl(fd, FIONREAD, &n) == 0 ? n : 0;
+    }
+
+    size_t read(byte *buffer, size_t length) override {
+        ssize_t n = ::read(fd, buffer, length);
+        return n > 0 ? n : 0;
+    }
+
+    // Waits for room rather than dropping bytes, as the SPP stack does
+    size_t write(const byte *buffer, size_t length) override {
+        size_t sent = 0;
+        while (sent < length) {
+            ssize_t n = ::write(fd, buffer + sent, length - sent);
+            if (n > 0) {
+                sent += n;
+            } else {
+                struct pollfd p = {fd, POLLOUT, 0};
+                if (poll(&p, 1, 1000) <= 0 || (p.revents & (POLLHUP | POLLERR))) break;
+            }
+        }
+        return sent;
+    }
+
+    void flush() override {}
+
+  private:
+    int fd = -1;
+};
+
+// A connected pair of sockets: device end, client end
+inline bool openSocketPair(int &device, int &client) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return false;
+    device = fds[0];
+    client = fds[1];
+    return true;
+}
+
+// A pty in raw mode: the device serves the master, a client opens `path`
+inline bool openPty(int &device, char *path, size_t pathLength) {
+    device = posix_openpt(O_RDWR | O_NOCTTY);
+    if (device < 0 || grantpt(device) != 0 || unlockpt(device) != 0) return false;
+    if (ptsname_r(device, path, pathLength) != 0) return false;
+
+    struct termios mode;
+    if (tcgetattr(device, &mode) != 0) return false;
+    cfmakeraw(&mode);
+    return tcsetattr(device, TCSANOW, &mode) == 0;
+}
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef LOOPBACK_TRANSPORT_H
+#define LOOPBACK_TRANSPORT_H
+
+#include "server.h"
+#include "transport.h"
+#include "utils.h"
+
+// ============================================================================
+//   Loopback Transport
+//   In-memory link for the protocol tests: the test sends what a client
+//   would and reads back what the device answered. Fixed buffers, so the
+//   link itself never allocates.
+// ============================================================================
+class ByteQueue {
+  public:
+    size_t size() const { return tail - head; }
+    bool push(byte c) {
+        if (size() == sizeof(data)) return false;
+        data[tail++ % sizeof(data)] = c;
+        return true;
+    }
+    int pop() { return size() > 0 ? data[head++ % sizeof(data)] : -1; }
+    int peek(size_t offset) const { return offset < size() ? data[(head + offset) % sizeof(data)] : -1; }
+    void clear() { head = tail = 0; }
+
+  private:
+    byte data[1 << 16];
+    size_t head = 0;
+    size_t tail = 0;
+};
+
+class LoopbackTransport : public Transport {
+  public:
+    bool attached = true;       // A client is attached
+    uint32_t flushes;           // flush() calls, one per finished response
+    uint32_t closes;            // close() calls
+    uint32_t reads;             // read() calls
+
+    bool connected() override { return attached; }
+    void close() override { closes++; }
+    int available() override { return toDevice.size(); }
+
+    size_t read(byte *buffer, size_t length) override {
+        reads++;
+        size_t n = 0;
+        for (int c; n < length && (c = toDevice.pop()) >= 0;) buffer[n++] = c;
+        return n;
+    }
+
+    size_t write(const byte *buffer, size_t length) override {
+        size_t n = 0;
+        while (n < length && fromDevice.push(buffer[n])) n++;
+        return n;
+    }
+
+    void flush() override { flushes++; }
+
+    // ------------------------------------------------------------------------
+    //   Client side
+    // ------------------------------------------------------------------------
+    void send(const byte *data, size_t length) {
+        for (size_t i = 0; i < length; i++) toDevice.push(data[i]);
+    }
+
+    size_t received() const { return fromDevice.size(); }
+    int receive() { return fromDevice.pop(); }
+    int peek(size_t offset) const { return fromDevice.peek(offset); }
+
+    // Drop what the device sent
+    void discard() { fromDevice.clear(); }
+
+    void reset() {
+        toDevice.clear();
+        fromDevice.clear();
+    }
+
+  private:
+    ByteQueue toDevice;
+    ByteQueue fromDevice;
+};
+
+// ============================================================================
+//   Client Frames
+//   v1: [length][payload]. v2: [length low][length high][payload].
+//   v3: v2 header, [seq], payload, then the CRC-16 of all of it.
+// ============================================================================
+inline size_t buildFrame(byte *frame, byte version, byte seq, const byte *payload, uint16_t length) {
+    size_t n = 0;
+    frame[n++] = length & 0xFF;
+    if (version != PROTOCOL_V1) frame[n++] = length >> 8;
+    if (version == PROTOCOL_V3) frame[n++] = seq;
+    memcpy(frame + n, payload, length);
+    n += length;
+    if (version == PROTOCOL_V3) {
+        uint16_t crc = crc16(frame, n);
+        frame[n++] = crc & 0xFF;
+        frame[n++] = crc >> 8;
+    }
+    return n;
+}
+
+// Take one response frame from the device. Returns its payload length, or
+// -1 if no full frame was received; `more` is set for v2/v3 chunks.
+inline int takeFrame(LoopbackTransport &link, byte version, byte *payload, byte *seq = NULL,
+                     bool *more = NULL, bool *crcOk = NULL) {
+    size_t header = version == PROTOCOL_V1 ? 1 : version == PROTOCOL_V2 ? 2 : 3;
+    if (link.received() < header) return -1;
+
+    uint16_t length = link.peek(0);
+    if (version != PROTOCOL_V1) length |= link.peek(1) << 8;
+    bool chunk = version != PROTOCOL_V1 && (length & 0x8000);
+    length &= version == PROTOCOL_V1 ? 0xFF : 0x7FFF;
+
+    size_t trailer = version == PROTOCOL_V3 ? 2 : 0;
+    if (link.received() < header + length + trailer) return -1;
+
+    byte head[3];
+    for (size_t i = 0; i < header; i++) head[i] = link.receive();
+    for (uint16_t i = 0; i < length; i++) payload[i] = link.receive();
+    if (seq != NULL) *seq = version == PROTOCOL_V3 ? head[2] : 0;
+    if (more != NULL) *more = chunk;
+
+    if (version == PROTOCOL_V3) {
+        uint16_t crc = crc16(payload, length, crc16(head, header));
+        uint16_t sent = link.receive();
+        sent |= link.receive() << 8;
+        if (crcOk != NULL) *crcOk = crc == sent;
+    }
+    return length;
+}
+
+#endif
@@ -0,0 +1,173 @@
+#include <unity.h>
+
+#include "buttons.h"
+#include "global_vars.h"
+#include "tasks.h"
+#include "utils.h"
+
+// ============================================================================
+//   Interrupt-Driven Buttons
+//   The GPIO is simulated: mockPinEdge() drives the pin and runs its
+//   interrupt, and readBtns() is called at each deadline it reports, as
+//   the UI task does. Nothing is polled while the buttons are idle.
+// ============================================================================
+struct PressTrace {
+    uint32_t count;             // Presses and repeats seen
+    uint32_t times[32];         // Tick of each
+};
+
+extern volatile uint32_t droppedEdges; // buttons.cpp
+
+// Run readBtns() now and at every button deadline until `until`
+static void runButtons(uint8_t pin, uint32_t until, PressTrace &trace) {
+    while (true) {
+        readBtns();
+        if (isPressed(pin)) {
+            if (trace.count < 32) trace.times[trace.count] = ticks;
+            trace.count++;
+        }
+
+        uint32_t wait = buttonsTimeLeft();
+        if (wait == NO_DEADLINE || ticks + wait > until) break;
+        ticks = ticks + wait;
+    }
+    ticks = until;
+}
+
+// A burst of bounces ending on `level`, 2 ms apart
+static void bounce(uint8_t pin, uint8_t level, byte edges) {
+    for (byte i = 0; i < edges; i++) {
+        mockPinEdge(pin, (edges - 1 - i) % 2 == 0 ? level : !level);
+        ticks = ticks + 2;
+    }
+}
+
+void setUp() {
+    mockPinEdge(UP_BTN, HIGH);
+    mockPinEdge(DOWN_BTN, HIGH);
+    mockPinEdge(LOCK_BTN, HIGH);
+
+    PressTrace trace = {};
+    runButtons(UP_BTN, ticks + 1000, trace);
+}
+
+void tearDown() {}
+
+void test_idle_buttons_have_no_deadline() {
+    TEST_ASSERT_EQUAL_UINT32(NO_DEADLINE, buttonsTimeLeft());
+
+    uint32_t reads = mockGpio.pinReads + mockGpio.regReads;
+    ticks = ticks + 60000;
+    TEST_ASSERT_EQUAL_UINT32(NO_DEADLINE, buttonsTimeLeft());
+    TEST_ASSERT_EQUAL_UINT32(reads, mockGpio.pinReads + mockGpio.regReads);
+}
+
+void test_bouncing_press_counts_once() {
+    PressTrace trace = {};
+    uint32_t start = ticks;
+
+    bounce(DOWN_BTN, LOW, 7);
+    runButtons(DOWN_BTN, start + 200, trace);
+    TEST_ASSERT_EQUAL_UINT32(1, trace.count);
+    TEST_ASSERT_EQUAL_UINT32(start + 14, trace.times[0]); // Read once the bounces are queued
+
+    bounce(DOWN_BTN, HIGH, 5);
+    runButtons(DOWN_BTN, ticks + 200, trace);
+    TEST_ASSERT_EQUAL_UINT32(1, trace.count);
+    TEST_ASSERT_EQUAL_UINT32(NO_DEADLINE, buttonsTimeLeft());
+}
+
+// A bounce that ends after the window still settles on the pin level
+void test_late_bounce_settles_on_pin_level() {
+    PressTrace trace = {};
+
+    mockPinEdge(UP_BTN, LOW);
+    readBtns();
+    TEST_ASSERT_TRUE(isPressed(UP_BTN));
+
+    ticks = ticks + DEBOUNCE_WINDOW + 5;
+    mockPinEdge(UP_BTN, HIGH); // Accepted as a release...
+    ticks = ticks + 1;
+    mockPinEdge(UP_BTN, LOW);  // ...inside its window, ignored
+    runButtons(UP_BTN, ticks + 100, trace);
+
+    TEST_ASSERT_EQUAL_UINT32(1, trace.count); // Pressed again when settled
+    TEST_ASSERT_EQUAL_UINT8(1, scrollStep(UP_BTN));
+    mockPinEdge(UP_BTN, HIGH);
+}
+
+void test_long_press_repeats() {
+    PressTrace trace = {};
+    uint32_t start = ticks;
+
+    mockPinEdge(UP_BTN, LOW);
+    runButtons(UP_BTN, start + 2000, trace);
+
+    // The press, then a repeat every REPEAT_PERIOD from LONG_PRESS on
+    TEST_ASSERT_EQUAL_UINT32(1 + (2000 - LONG_PRESS) / REPEAT_PERIOD + 1, trace.count);
+    TEST_ASSERT_EQUAL_UINT32(start, trace.times[0]);
+    for (uint32_t i = 1; i < trace.count; i++) {
+        TEST_ASSERT_EQUAL_UINT32(start + LONG_PRESS + (i - 1) * REPEAT_PERIOD, trace.times[i]);
+    }
+
+    mockPinEdge(UP_BTN, HIGH);
+    runButtons(UP_BTN, ticks + 1000, trace);
+    TEST_ASSERT_EQUAL_UINT32(1 + (2000 - LONG_PRESS) / REPEAT_PERIOD + 1, trace.count);
+}
+
+void test_fast_scroll_after_long_hold() {
+    PressTrace trace = {};
+    uint32_t start = ticks;
+
+    mockPinEdge(DOWN_BTN, LOW);
+    runButtons(DOWN_BTN, start + FAST_SCROLL_AFTER - 1, trace);
+    TEST_ASSERT_EQUAL_UINT8(1, scrollStep(DOWN_BTN));
+
+    runButtons(DOWN_BTN, start + FAST_SCROLL_AFTER, trace);
+    TEST_ASSERT_EQUAL_UINT8(FAST_SCROLL_STEP, scrollStep(DOWN_BTN));
+
+    mockPinEdge(DOWN_BTN, HIGH);
+    runButtons(DOWN_BTN, ticks + 100, trace);
+    TEST_ASSERT_EQUAL_UINT8(1, scrollStep(DOWN_BTN));
+}
+
+void test_lock_button_does_not_repeat() {
+    PressTrace trace = {};
+
+    mockPinEdge(LOCK_BTN, LOW);
+    runButtons(LOCK_BTN, ticks + 3000, trace);
+    TEST_ASSERT_EQUAL_UINT32(1, trace.count);
+    TEST_ASSERT_EQUAL_UINT32(NO_DEADLINE, buttonsTimeLeft());
+    mockPinEdge(LOCK_BTN, HIGH);
+}
+
+// A full queue drops edges; the pin is read back once they stop
+void test_dropped_edges_recover_state() {
+    PressTrace trace = {};
+    uint32_t dropped = droppedEdges;
+
+    bounce(UP_BTN, LOW, 2 * BUTTON_QUEUE_SIZE + 1);
+    TEST_ASSERT_GREATER_THAN(dropped, droppedEdges);
+    runButtons(UP_BTN, ticks + 100, trace);
+    TEST_ASSERT_EQUAL_UINT32(1, trace.count);
+
+    bounce(UP_BTN, HIGH, 2 * BUTTON_QUEUE_SIZE + 1);
+    runButtons(UP_BTN, ticks + 100, trace);
+    TEST_ASSERT_EQUAL_UINT32(1, trace.count);
+    TEST_ASSERT_EQUAL_UINT32(NO_DEADLINE, buttonsTimeLeft()); // Released, no repeat left
+}
+
+int main() {
+    initButtons();
+    startTasks(); // Queues only: the tasks never run on the host
+
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_buttons_have_no_deadline);
+    RUN_TEST(test_bouncing_press_counts_once);
+    RUN_TEST(test_late_bounce_settles_on_pin_level);
+    RUN_TEST(test_long_press_repeats);
+    RUN_TEST(test_fast_scroll_after_long_hold);
+    RUN_TEST(test_lock_button_does_not_repeat);
+    RUN_TEST(test_dropped_edges_recover_state);
+    return UNITY_END();
+}
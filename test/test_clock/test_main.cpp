@@ -0,0 +1,162 @@
+#include <unity.h>
+
+#include "global_vars.h"
+#include "utils.h"
+
+// ============================================================================
+//   Burst RTC Read and Software Clock
+//   The I2C bus is mocked with a virtual DS3231 that follows the tick
+//   counter. Transactions are counted against the baseline, which read
+//   eight registers every second: 16 transactions per second.
+// ============================================================================
+#define POLLING_TRANSACTIONS 16
+
+// Check `time` against the virtual RTC
+static void expectRtcTime(const ClockTime &time) {
+    int64_t now = Wire.rtc.now();
+    unsigned int year;
+    byte month, day;
+    Wire.rtc.date(year, month, day);
+
+    TEST_ASSERT_EQUAL_UINT(year, time.year);
+    TEST_ASSERT_EQUAL_UINT8(month, time.month);
+    TEST_ASSERT_EQUAL_UINT8(day, time.day);
+    TEST_ASSERT_EQUAL_UINT8(Wire.rtc.dayOfWeek(), time.dayOfWeek);
+    TEST_ASSERT_EQUAL_UINT8(now / 3600 % 24, time.hour);
+    TEST_ASSERT_EQUAL_UINT8(now / 60 % 60, time.minute);
+    TEST_ASSERT_EQUAL_UINT8(now % 60, time.second);
+}
+
+// Call serviceClock() once per second for `seconds`, as the home screen
+// does, checking the clock each time
+static void runSeconds(uint32_t seconds, uint32_t offset = 0) {
+    ticks = ticks + offset;
+    for (uint32_t i = 0; i < seconds; i++) {
+        ticks = ticks + 1000;
+        serviceClock();
+        expectRtcTime(getClock());
+    }
+}
+
+static void startAt(unsigned int year, byte month, byte day, byte dayOfWeek, byte hour, byte minute, byte second) {
+    Wire.rtc.set(year, month, day, dayOfWeek, hour, minute, second);
+    resyncClock();
+    serviceClock();
+    Wire.transactions = 0;
+}
+
+void setUp() {
+    Wire.failing = false;
+    Wire.rtc.temperature = 21.25f;
+    startAt(2026, 10, 18, 1, 12, 0, 0);
+}
+
+void tearDown() {}
+
+void test_hour_of_clock_costs_few_transactions() {
+    runSeconds(3600);
+
+    // One burst per RTC_SYNC_PERIOD and one temperature read per TEMP_PERIOD,
+    // each a write of the register pointer and a read
+    uint32_t expected = 2 * (3600 / RTC_SYNC_PERIOD) + 2 * (3600 / TEMP_PERIOD);
+    TEST_ASSERT_LESS_OR_EQUAL(expected + 4, Wire.transactions);
+    TEST_ASSERT_LESS_THAN(3600 * POLLING_TRANSACTIONS / 10, Wire.transactions);
+
+    char text[100];
+    snprintf(text, sizeof(text), "%u I2C transactions in an hour, %u with per-register polling",
+             (unsigned)Wire.transactions, (unsigned)(3600 * POLLING_TRANSACTIONS));
+    TEST_MESSAGE(text);
+}
+
+void test_get_clock_touches_no_bus() {
+    for (int i = 0; i < 1000; i++) {
+        ticks = ticks + 37;
+        expectRtcTime(getClock());
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, Wire.transactions);
+}
+
+// Off the second boundary the clock still shows the right second
+void test_clock_between_seconds() {
+    runSeconds(120, 499);
+    runSeconds(120, 1);
+}
+
+void test_midnight_rollover() {
+    startAt(2026, 10, 18, 1, 23, 59, 30);
+    runSeconds(60);
+    TEST_ASSERT_EQUAL_UINT8(2, getClock().dayOfWeek);
+}
+
+// Without serviceClock(), getClock() advances the date on its own
+void test_rollover_without_resync() {
+    startAt(2026, 10, 31, 7, 23, 59, 0);
+    ticks = ticks + 5 * 60000UL;
+
+    ClockTime time = getClock();
+    expectRtcTime(time);
+    TEST_ASSERT_EQUAL_UINT8(11, time.month);
+    TEST_ASSERT_EQUAL_UINT8(1, time.day);
+    TEST_ASSERT_EQUAL_UINT8(1, time.dayOfWeek);
+    TEST_ASSERT_EQUAL_UINT32(0, Wire.transactions);
+}
+
+void test_month_and_year_rollover() {
+    startAt(2026, 12, 31, 5, 23, 59, 50);
+    runSeconds(20);
+    TEST_ASSERT_EQUAL_UINT(2027, getClock().year);
+    TEST_ASSERT_EQUAL_UINT8(1, getClock().month);
+
+    startAt(2028, 2, 28, 2, 23, 59, 50); // Leap year
+    runSeconds(20);
+    TEST_ASSERT_EQUAL_UINT8(29, getClock().day);
+}
+
+void test_set_clock_is_one_transaction() {
+    ClockTime time = {8, 30, 15, 3, 4, 6, 0, 2027, 0};
+
+    TEST_ASSERT_TRUE(setClock(time));
+    TEST_ASSERT_EQUAL_UINT32(1, Wire.transactions);
+
+    serviceClock(); // Resynced at once
+    TEST_ASSERT_EQUAL_UINT32(3, Wire.transactions);
+    expectRtcTime(getClock());
+    TEST_ASSERT_EQUAL_UINT8(30, getClock().minute);
+    TEST_ASSERT_EQUAL_UINT(2027, getClock().year);
+}
+
+void test_temperature_follows_its_period() {
+    // Wait for a temperature read, then change the temperature
+    Wire.rtc.temperature = 25.75f;
+    for (int i = 0; i <= TEMP_PERIOD && getClock().temperature != 26; i++) runSeconds(1);
+    TEST_ASSERT_EQUAL_UINT8(26, getClock().temperature);
+
+    Wire.rtc.temperature = 30.0f;
+    runSeconds(TEMP_PERIOD - 1);
+    TEST_ASSERT_EQUAL_UINT8(26, getClock().temperature);
+    runSeconds(2);
+    TEST_ASSERT_EQUAL_UINT8(30, getClock().temperature);
+}
+
+// A failed burst keeps the clock counting from the last one
+void test_bus_failure_keeps_counting() {
+    Wire.failing = true;
+    runSeconds(3 * RTC_SYNC_PERIOD);
+
+    Wire.failing = false;
+    runSeconds(RTC_SYNC_PERIOD);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_hour_of_clock_costs_few_transactions);
+    RUN_TEST(test_get_clock_touches_no_bus);
+    RUN_TEST(test_clock_between_seconds);
+    RUN_TEST(test_midnight_rollover);
+    RUN_TEST(test_rollover_without_resync);
+    RUN_TEST(test_month_and_year_rollover);
+    RUN_TEST(test_set_clock_is_one_transaction);
+    RUN_TEST(test_temperature_follows_its_period);
+    RUN_TEST(test_bus_failure_keeps_counting);
+    return UNITY_END();
+}
@@ -0,0 +1,229 @@
+#include <chrono>
+#include <unity.h>
+
+#include "database.h"
+#include "global_vars.h"
+#include "schedule.h"
+
+// ============================================================================
+//   NVS Record
+//   The configuration goes through the host NVS of test/native/Preferences.h.
+//   Boot is measured in key operations and time for the legacy one-key-per-
+//   element layout and for the record; edits, corrupted pages and power cuts
+//   must leave a configuration that loads.
+// ============================================================================
+extern uint32_t dirtyPages; // database.cpp
+
+static void fillConfig(uint16_t count, byte duration) {
+    memset(&eeprom, 0, sizeof(eeprom));
+    eeprom.alarmCount = count;
+    for (uint16_t i = 0; i < count; i++) eeprom.alarms[i] = packAlarm(i % 24, i % 60, duration, 0xFF);
+    eeprom.programType = 1;
+    eeprom.state = 1;
+    for (byte i = 0; i < PASSWORD_LEN; i++) eeprom.password[i] = 0xC0 + i;
+    eeprom.descriptionLength = 11;
+    memcpy(eeprom.description, "Bell system", 11);
+    eeprom.authorLength = 6;
+    memcpy(eeprom.author, "Author", 6);
+}
+
+// The keys written by the firmware before the record
+static void storeLegacyKeys() {
+    char key[16];
+    preferences.putInt(PROGRAM_TYPE_KEY, eeprom.programType);
+    preferences.putInt(NBR_ALARMS_KEY, eeprom.alarmCount);
+    for (uint16_t page = 0; page < ALARMS_PAGES(eeprom.alarmCount); page++) {
+        uint16_t first = page * ALARMS_PAGE_SIZE;
+        snprintf(key, sizeof(key), ALARMS_PAGE_KEY, page);
+        preferences.putBytes(key, &eeprom.alarms[first],
+                             min<uint16_t>(ALARMS_PAGE_SIZE, eeprom.alarmCount - first) * sizeof(Alarm));
+    }
+    preferences.putBytes(PASSWORD_KEY, eeprom.password, PASSWORD_LEN);
+    preferences.putInt(DESCRIPTION_LEN_KEY, eeprom.descriptionLength);
+    preferences.putBytes(DESCRIPTION_KEY, eeprom.description, eeprom.descriptionLength);
+    preferences.putInt(AUTHOR_LEN_KEY, eeprom.authorLength);
+    preferences.putBytes(AUTHOR_KEY, eeprom.author, eeprom.authorLength);
+    preferences.putInt(STATE_KEY, eeprom.state);
+}
+
+// Power up: eeprom is lost, NVS is kept. Returns the loadRecord() result.
+static bool reboot() {
+    memset(&eeprom, 0, sizeof(eeprom));
+    dirtyPages = 0;
+    return loadRecord();
+}
+
+static double bootMicros(bool &ok) {
+    auto start = std::chrono::steady_clock::now();
+    ok = reboot();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A configuration of `count` alarms, migrated to the record
+static EEPROMData installed;
+
+static void install(uint16_t count, byte duration) {
+    fillConfig(count, duration);
+    storeLegacyKeys();
+    installed = eeprom;
+    TEST_ASSERT_TRUE(reboot());
+}
+
+static void expectInstalled() {
+    TEST_ASSERT_EQUAL_UINT16(installed.alarmCount, eeprom.alarmCount);
+    TEST_ASSERT_EQUAL_MEMORY(installed.alarms, eeprom.alarms, installed.alarmCount * sizeof(Alarm));
+    TEST_ASSERT_EQUAL_UINT8(installed.programType, eeprom.programType);
+    TEST_ASSERT_EQUAL_UINT8(installed.state, eeprom.state);
+    TEST_ASSERT_EQUAL_MEMORY(installed.password, eeprom.password, PASSWORD_LEN);
+    TEST_ASSERT_EQUAL_UINT8(installed.descriptionLength, eeprom.descriptionLength);
+    TEST_ASSERT_EQUAL_MEMORY(installed.description, eeprom.description, installed.descriptionLength);
+    TEST_ASSERT_EQUAL_UINT8(installed.authorLength, eeprom.authorLength);
+    TEST_ASSERT_EQUAL_MEMORY(installed.author, eeprom.author, installed.authorLength);
+}
+
+void setUp() {
+    mockNvs.clear();
+    preferences.begin(DB_NAME, false);
+}
+
+void tearDown() {
+    preferences.end();
+}
+
+void test_boot_key_operations() {
+    bool ok;
+    fillConfig(MAX_ALARMS, 5);
+    storeLegacyKeys();
+
+    // The old firmware: every key read, nothing written
+    mockNvs.writesLeft = 0;
+    mockNvs.reads = 0;
+    double legacyMicros = bootMicros(ok);
+    uint32_t legacyReads = mockNvs.reads;
+    TEST_ASSERT_TRUE(ok);
+    TEST_ASSERT_EQUAL_UINT16(MAX_ALARMS, eeprom.alarmCount);
+
+    // First boot after the update: the legacy keys become the record
+    mockNvs.writesLeft = -1;
+    TEST_ASSERT_TRUE(reboot());
+    TEST_ASSERT_FALSE(mockNvs.keys.count(NBR_ALARMS_KEY));
+
+    mockNvs.reads = mockNvs.writes = 0;
+    double recordMicros = bootMicros(ok);
+    TEST_ASSERT_TRUE(ok);
+    TEST_ASSERT_EQUAL_UINT16(MAX_ALARMS, eeprom.alarmCount);
+    TEST_ASSERT_EQUAL_UINT32(1 + RECORD_PAGES, mockNvs.reads); // Record, then its pages
+    TEST_ASSERT_LESS_THAN(legacyReads, mockNvs.reads);
+    TEST_ASSERT_EQUAL_UINT32(0, mockNvs.writes);
+
+    char text[120];
+    snprintf(text, sizeof(text), "boot, %u alarms: legacy %u key reads in %.0f us, record %u in %.0f us",
+             MAX_ALARMS, (unsigned)legacyReads, legacyMicros, (unsigned)mockNvs.reads, recordMicros);
+    TEST_MESSAGE(text);
+}
+
+void test_migration_round_trip() {
+    install(70, 9);
+    expectInstalled();
+
+    // Only the record and its pages are left
+    char key[16];
+    snprintf(key, sizeof(key), ALARMS_PAGE_KEY, 0);
+    TEST_ASSERT_FALSE(mockNvs.keys.count(key));
+    TEST_ASSERT_TRUE(mockNvs.keys.count(RECORD_KEY));
+
+    TEST_ASSERT_TRUE(reboot());
+    expectInstalled();
+}
+
+void test_store_round_trip() {
+    install(3, 9);
+    fillConfig(ALARMS_PAGE_SIZE * 2 + 1, 17);
+    installed = eeprom;
+    markAlarmsDirty(0, eeprom.alarmCount);
+    TEST_ASSERT_TRUE(storeRecord());
+
+    TEST_ASSERT_TRUE(reboot());
+    expectInstalled();
+
+    // The loaded table is compiled
+    const Schedule *table = acquireSchedule();
+    TEST_ASSERT_EQUAL_UINT16(installed.alarmCount, table->alarmCount);
+    releaseSchedule(table);
+}
+
+// A page that fails its checks keeps the alarms before it
+void test_corrupted_page_truncates_the_table() {
+    install(3 * ALARMS_PAGE_SIZE, 9);
+
+    char key[16];
+    for (byte slot = 0; slot < 2; slot++) {
+        snprintf(key, sizeof(key), RECORD_PAGE_KEY, 1, slot);
+        if (mockNvs.keys.count(key)) mockNvs.keys[key].back() ^= 0x01;
+    }
+
+    TEST_ASSERT_FALSE(reboot());
+    TEST_ASSERT_EQUAL_UINT16(ALARMS_PAGE_SIZE, eeprom.alarmCount);
+    TEST_ASSERT_EQUAL_MEMORY(installed.alarms, eeprom.alarms, ALARMS_PAGE_SIZE * sizeof(Alarm));
+    TEST_ASSERT_EQUAL_MEMORY(installed.password, eeprom.password, PASSWORD_LEN);
+}
+
+void test_corrupted_record_is_not_loaded() {
+    install(10, 9);
+    mockNvs.keys[RECORD_KEY][sizeof(uint16_t) * 4] ^= 0x01; // First byte after the header
+
+    TEST_ASSERT_FALSE(reboot()); // No record and no legacy keys
+}
+
+// Editing one alarm rewrites its page and the record, not the table
+void test_single_alarm_edit() {
+    install(MAX_ALARMS, 9);
+
+    mockNvs.writes = 0;
+    mockNvs.bytesWritten = 0;
+    eeprom.alarms[100] = packAlarm(6, 30, 44, 0xFF);
+    markAlarmsDirty(100, 101);
+    TEST_ASSERT_TRUE(storeRecord());
+
+    TEST_ASSERT_EQUAL_UINT32(2, mockNvs.writes);
+    TEST_ASSERT_LESS_THAN(MAX_ALARMS * sizeof(Alarm), mockNvs.bytesWritten);
+
+    char text[80];
+    snprintf(text, sizeof(text), "one alarm edit: %u writes, %u bytes",
+             (unsigned)mockNvs.writes, (unsigned)mockNvs.bytesWritten);
+    TEST_MESSAGE(text);
+
+    installed.alarms[100] = packAlarm(6, 30, 44, 0xFF);
+    TEST_ASSERT_TRUE(reboot());
+    expectInstalled();
+}
+
+// Cut after the page writes, before the record: the old configuration loads
+void test_power_cut_keeps_the_old_config() {
+    install(3 * ALARMS_PAGE_SIZE, 9);
+
+    for (int cut = 0; cut <= 3; cut++) {
+        for (uint16_t i = 0; i < eeprom.alarmCount; i++) eeprom.alarms[i] = packAlarm(1, 2, 33, 0xFF);
+        eeprom.state = 0;
+        markAlarmsDirty(0, eeprom.alarmCount);
+
+        mockNvs.writesLeft = cut; // The first `cut` pages written, the record never is
+        TEST_ASSERT_FALSE(storeRecord());
+        mockNvs.writesLeft = -1;
+
+        TEST_ASSERT_TRUE(reboot());
+        expectInstalled();
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_boot_key_operations);
+    RUN_TEST(test_migration_round_trip);
+    RUN_TEST(test_store_round_trip);
+    RUN_TEST(test_corrupted_page_truncates_the_table);
+    RUN_TEST(test_corrupted_record_is_not_loaded);
+    RUN_TEST(test_single_alarm_edit);
+    RUN_TEST(test_power_cut_keeps_the_old_config);
+    return UNITY_END();
+}
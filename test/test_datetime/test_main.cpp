@@ -0,0 +1,155 @@
+#include <unity.h>
+
+#include "global_vars.h"
+#include "loopback_transport.h"
+#include "schedule.h"
+#include "server.h"
+#include "tasks.h"
+#include "utils.h"
+
+// ============================================================================
+//   Date, Time and Status Records
+//   GET_DATETIME and GET_STATUS are read field by field against the virtual
+//   DS3231 of test/native/Wire.h. SET_DATETIME must write the RTC, and
+//   leave it untouched when the date does not exist.
+// ============================================================================
+static LoopbackTransport link;
+
+// One v1 request, its response payload in `payload`; -1 if none
+static int exchange(const byte *request, byte length, byte *payload) {
+    byte frame[256];
+    frame[0] = length;
+    memcpy(frame + 1, request, length);
+    link.send(frame, 1 + length);
+    execRequest();
+    return takeFrame(link, PROTOCOL_V1, payload);
+}
+
+// POST_PASSWORD then SET_DATETIME; returns the status of the last frame
+static byte setDateTime(byte year, byte month, byte day, byte dayOfWeek, byte hour, byte minute, byte second) {
+    byte request[64], payload[16];
+    byte length = 0;
+
+    request[length++] = POST_PASSWORD;
+    for (byte i = 0; i < PASSWORD_LEN; i++) request[length++] = eeprom.password[i];
+    request[length++] = SET_DATETIME;
+    request[length++] = year;
+    request[length++] = month;
+    request[length++] = day;
+    request[length++] = dayOfWeek;
+    request[length++] = hour;
+    request[length++] = minute;
+    request[length++] = second;
+
+    int n = exchange(request, length, payload);
+    TEST_ASSERT_GREATER_THAN(0, n);
+    return n == 2 ? payload[1] : payload[0];
+}
+
+static void expectRtc(unsigned int year, byte month, byte day, byte dayOfWeek, byte hour, byte minute, byte second) {
+    unsigned int rtcYear;
+    byte rtcMonth, rtcDay;
+    Wire.rtc.date(rtcYear, rtcMonth, rtcDay);
+    int64_t now = Wire.rtc.now();
+
+    TEST_ASSERT_EQUAL_UINT(year, rtcYear);
+    TEST_ASSERT_EQUAL_UINT8(month, rtcMonth);
+    TEST_ASSERT_EQUAL_UINT8(day, rtcDay);
+    TEST_ASSERT_EQUAL_UINT8(dayOfWeek, Wire.rtc.dayOfWeek());
+    TEST_ASSERT_EQUAL_UINT8(hour, now / 3600 % 24);
+    TEST_ASSERT_EQUAL_UINT8(minute, now / 60 % 60);
+    TEST_ASSERT_EQUAL_UINT8(second, now % 60);
+}
+
+void setUp() {
+    memset(&eeprom, 0, sizeof(eeprom));
+    eeprom.state = 1;
+    eeprom.programType = 1;
+    eeprom.alarmCount = 300;
+    for (uint16_t i = 0; i < eeprom.alarmCount; i++) eeprom.alarms[i] = packAlarm(i % 24, i % 60, 1, 0xFF);
+    for (byte i = 0; i < PASSWORD_LEN; i++) eeprom.password[i] = 0xA0 + i;
+    compileSchedule();
+
+    Wire.failing = false;
+    Wire.rtc.temperature = 23.25f;
+    Wire.rtc.set(2026, 10, 17, 7, 14, 35, 9);
+    resyncClock();
+    serviceClock();
+    link.reset();
+}
+
+void tearDown() {}
+
+// [SET_DATETIME][year - 1970][month][day][day of week][hour][minute][second]
+void test_get_datetime_layout() {
+    const byte request[] = {GET_DATETIME};
+    const byte expected[] = {SET_DATETIME, 56, 10, 17, 7, 14, 35, 9};
+    byte payload[64];
+
+    TEST_ASSERT_EQUAL_INT(sizeof(expected), exchange(request, sizeof(request), payload));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, payload, sizeof(expected));
+}
+
+// Date and time, temperature, state, program type, alarm count, schedule version
+void test_get_status_layout() {
+    const byte request[] = {GET_STATUS};
+    byte payload[64];
+
+    TEST_ASSERT_EQUAL_INT(15, exchange(request, sizeof(request), payload));
+    const byte clock[] = {SET_STATUS, 56, 10, 17, 7, 14, 35, 9};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(clock, payload, sizeof(clock));
+    TEST_ASSERT_EQUAL_INT(23, (int8_t)payload[8]);
+    TEST_ASSERT_EQUAL_UINT8(1, payload[9]);
+    TEST_ASSERT_EQUAL_UINT8(1, payload[10]);
+    TEST_ASSERT_EQUAL_UINT16(300, payload[11] | payload[12] << 8);
+    TEST_ASSERT_EQUAL_UINT16(scheduleVersion(), payload[13] | payload[14] << 8);
+
+    // A new schedule shows up in the next record
+    uint16_t version = scheduleVersion();
+    compileSchedule();
+    TEST_ASSERT_EQUAL_INT(15, exchange(request, sizeof(request), payload));
+    TEST_ASSERT_EQUAL_UINT16(version + 1, payload[13] | payload[14] << 8);
+}
+
+void test_set_datetime_writes_the_rtc() {
+    TEST_ASSERT_EQUAL_HEX8(PASSWORD_RESPONSE_CORRECT, setDateTime(58, 2, 29, 3, 23, 59, 30)); // 2028 is a leap year
+    expectRtc(2028, 2, 29, 3, 23, 59, 30);
+    serviceClock(); // The UI task picks up the new time
+
+    const byte request[] = {GET_DATETIME};
+    const byte expected[] = {SET_DATETIME, 58, 2, 29, 3, 23, 59, 30};
+    byte payload[64];
+    TEST_ASSERT_EQUAL_INT(sizeof(expected), exchange(request, sizeof(request), payload));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, payload, sizeof(expected));
+}
+
+// Days past the end of the month are rejected before anything is written
+void test_invalid_date_leaves_the_rtc() {
+    const byte dates[][3] = {
+        {56, 2, 29}, // 2026 is not a leap year
+        {56, 2, 30},
+        {56, 4, 31},
+        {56, 11, 31},
+        {56, 13, 1},
+        {56, 6, 0},
+    };
+
+    for (const auto &date : dates) {
+        Wire.transactions = 0;
+        TEST_ASSERT_EQUAL_HEX8(BAD_REQUEST, setDateTime(date[0], date[1], date[2], 2, 8, 0, 0));
+        TEST_ASSERT_EQUAL_UINT32(0, Wire.transactions);
+        expectRtc(2026, 10, 17, 7, 14, 35, 9);
+    }
+}
+
+int main() {
+    startTasks(); // Queues only: the tasks never run on the host
+    registerTransport(link);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_get_datetime_layout);
+    RUN_TEST(test_get_status_layout);
+    RUN_TEST(test_set_datetime_writes_the_rtc);
+    RUN_TEST(test_invalid_date_leaves_the_rtc);
+    return UNITY_END();
+}
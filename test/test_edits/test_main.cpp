@@ -0,0 +1,247 @@
+#include <unity.h>
+#include <vector>
+
+#include "database.h"
+#include "global_vars.h"
+#include "loopback_transport.h"
+#include "schedule.h"
+#include "server.h"
+#include "tasks.h"
+
+// ============================================================================
+//   Alarm Edits by Index
+//   UPDATE_ALARMS, INSERT_ALARMS and DELETE_ALARMS go through the protocol
+//   and are checked against a model of the table: in RAM, in the published
+//   schedule and in flash after a reboot. Flash writes are counted with the
+//   host NVS of test/native/Preferences.h.
+// ============================================================================
+extern uint32_t dirtyPages; // database.cpp
+
+static LoopbackTransport link;
+static std::vector<Alarm> model; // What the table must hold
+
+// Request under construction, starting with POST_PASSWORD
+struct Request {
+    byte data[256];
+    byte length;
+};
+
+static Alarm alarmFor(uint16_t i, byte tag) {
+    return packAlarm(i % 24, i % 60, tag, 0xFF);
+}
+
+static void beginRequest(Request &request) {
+    request.length = 0;
+    request.data[request.length++] = POST_PASSWORD;
+    for (byte i = 0; i < PASSWORD_LEN; i++) request.data[request.length++] = eeprom.password[i];
+}
+
+static void putWord(Request &request, uint16_t x) {
+    request.data[request.length++] = x & 0xFF;
+    request.data[request.length++] = x >> 8;
+}
+
+// UPDATE_ALARMS or INSERT_ALARMS of `n` alarms tagged with `tag`
+static void addEdit(Request &request, byte code, uint16_t index, byte n, byte tag) {
+    request.data[request.length++] = code;
+    putWord(request, index);
+    request.data[request.length++] = n;
+    for (byte i = 0; i < n; i++) {
+        Alarm alarm = alarmFor(index + i, tag);
+        memcpy(request.data + request.length, &alarm, sizeof(alarm));
+        request.length += sizeof(alarm);
+    }
+}
+
+static void addDelete(Request &request, uint16_t index, uint16_t n) {
+    request.data[request.length++] = DELETE_ALARMS;
+    putWord(request, index);
+    putWord(request, n);
+}
+
+// Apply an edit to the model
+static void modelEdit(byte code, uint16_t index, byte n, byte tag) {
+    for (byte i = 0; i < n; i++) {
+        if (code == INSERT_ALARMS) model.insert(model.begin() + index + i, alarmFor(index + i, tag));
+        else model[index + i] = alarmFor(index + i, tag);
+    }
+}
+
+// Send the request, returns the status of its password response, or the
+// status frame if the request was rejected
+static byte exchange(const Request &request) {
+    byte frame[257], payload[64];
+    frame[0] = request.length;
+    memcpy(frame + 1, request.data, request.length);
+    link.send(frame, 1 + request.length);
+    execRequest();
+
+    int length = takeFrame(link, PROTOCOL_V1, payload);
+    TEST_ASSERT_GREATER_THAN(0, length);
+    return length == 2 && payload[0] == POST_PASSWORD_RESPONSE ? payload[1] : payload[0];
+}
+
+// Power up: eeprom is lost, NVS is kept
+static void reboot() {
+    EEPROMData saved = eeprom;
+    memset(&eeprom, 0, sizeof(eeprom));
+    dirtyPages = 0;
+    preferences.begin(DB_NAME, false);
+    TEST_ASSERT_TRUE(loadRecord());
+    preferences.end();
+    memcpy(eeprom.password, saved.password, PASSWORD_LEN);
+}
+
+static void expectModel() {
+    TEST_ASSERT_EQUAL_UINT16(model.size(), eeprom.alarmCount);
+    TEST_ASSERT_EQUAL_MEMORY(model.data(), eeprom.alarms, model.size() * sizeof(Alarm));
+
+    const Schedule *table = acquireSchedule();
+    TEST_ASSERT_EQUAL_UINT16(model.size(), table->alarmCount);
+    TEST_ASSERT_EQUAL_MEMORY(model.data(), table->alarms, model.size() * sizeof(Alarm));
+    releaseSchedule(table);
+}
+
+// RAM, schedule, then flash
+static void expectStored() {
+    expectModel();
+    reboot();
+    expectModel();
+}
+
+// A `count` alarm table, stored in flash
+static void install(uint16_t count) {
+    memset(&eeprom, 0, sizeof(eeprom));
+    eeprom.state = 1;
+    for (byte i = 0; i < PASSWORD_LEN; i++) eeprom.password[i] = 0xA0 + i;
+    model.clear();
+    for (uint16_t i = 0; i < count; i++) model.push_back(alarmFor(i, 1));
+    eeprom.alarmCount = count;
+    memcpy(eeprom.alarms, model.data(), count * sizeof(Alarm));
+
+    mockNvs.clear();
+    preferences.begin(DB_NAME, false);
+    markAlarmsDirty(0, count);
+    TEST_ASSERT_TRUE(storeRecord());
+    preferences.end();
+    reboot();
+}
+
+void setUp() {
+    link.reset();
+}
+
+void tearDown() {}
+
+// One alarm changed: its page and the record are written, nothing else
+void test_update_writes_one_page() {
+    install(MAX_ALARMS);
+    uint16_t version = scheduleVersion();
+
+    Request request;
+    beginRequest(request);
+    addEdit(request, UPDATE_ALARMS, 500, 1, 77);
+    modelEdit(UPDATE_ALARMS, 500, 1, 77);
+
+    mockNvs.writes = 0;
+    mockNvs.bytesWritten = 0;
+    TEST_ASSERT_EQUAL_HEX8(PASSWORD_RESPONSE_CORRECT, exchange(request));
+    TEST_ASSERT_EQUAL_UINT32(2, mockNvs.writes); // One page blob, then the record
+    TEST_ASSERT_LESS_THAN(MAX_ALARMS * sizeof(Alarm), mockNvs.bytesWritten);
+    TEST_ASSERT_EQUAL_UINT16(version + 1, scheduleVersion());
+    expectStored();
+}
+
+void test_inserts_are_stored() {
+    const uint16_t count = 2 * ALARMS_PAGE_SIZE + 10;
+    const uint16_t at[] = {0, ALARMS_PAGE_SIZE + 3, 0xFFFF}; // 0xFFFF: at the end
+    install(count);
+
+    for (byte k = 0; k < 3; k++) {
+        uint16_t index = at[k] == 0xFFFF ? model.size() : at[k];
+        uint16_t version = scheduleVersion();
+
+        Request request;
+        beginRequest(request);
+        addEdit(request, INSERT_ALARMS, index, 3, 20 + k);
+        modelEdit(INSERT_ALARMS, index, 3, 20 + k);
+
+        TEST_ASSERT_EQUAL_HEX8(PASSWORD_RESPONSE_CORRECT, exchange(request));
+        TEST_ASSERT_EQUAL_UINT16(version + 1, scheduleVersion());
+        expectStored();
+    }
+    TEST_ASSERT_EQUAL_UINT16(count + 9, eeprom.alarmCount);
+}
+
+// The table shrinks to exactly two pages: the last page is full
+void test_delete_onto_page_boundary() {
+    install(2 * ALARMS_PAGE_SIZE + 5);
+
+    Request request;
+    beginRequest(request);
+    addDelete(request, 10, 5);
+    model.erase(model.begin() + 10, model.begin() + 15);
+
+    TEST_ASSERT_EQUAL_HEX8(PASSWORD_RESPONSE_CORRECT, exchange(request));
+    TEST_ASSERT_EQUAL_UINT16(2 * ALARMS_PAGE_SIZE, eeprom.alarmCount);
+    expectStored();
+}
+
+// Each command is validated against the count left by the ones before it
+void test_edits_in_one_frame() {
+    install(10);
+    uint16_t version = scheduleVersion();
+
+    Request request;
+    beginRequest(request);
+    addEdit(request, INSERT_ALARMS, 10, 3, 30);  // 13 alarms
+    addEdit(request, UPDATE_ALARMS, 12, 1, 31);  // Only valid after the insert
+    addDelete(request, 0, 4);                    // 9 alarms
+    addEdit(request, UPDATE_ALARMS, 8, 1, 32);
+    modelEdit(INSERT_ALARMS, 10, 3, 30);
+    modelEdit(UPDATE_ALARMS, 12, 1, 31);
+    model.erase(model.begin(), model.begin() + 4);
+    modelEdit(UPDATE_ALARMS, 8, 1, 32);
+
+    TEST_ASSERT_EQUAL_HEX8(PASSWORD_RESPONSE_CORRECT, exchange(request));
+    TEST_ASSERT_EQUAL_UINT16(version + 4, scheduleVersion()); // One per edit
+    expectStored();
+}
+
+// An index past the table rejects the whole request, earlier edits included
+void test_out_of_range_index_applies_nothing() {
+    install(10);
+    uint16_t version = scheduleVersion();
+    uint32_t writes = mockNvs.writes;
+
+    const byte code[] = {UPDATE_ALARMS, INSERT_ALARMS};
+    for (byte k = 0; k < 2; k++) {
+        Request request;
+        beginRequest(request);
+        addEdit(request, UPDATE_ALARMS, 0, 2, 40);
+        addEdit(request, code[k], 11, 1, 41);
+        TEST_ASSERT_EQUAL_HEX8(BAD_REQUEST, exchange(request));
+    }
+
+    Request request;
+    beginRequest(request);
+    addDelete(request, 8, 3);
+    TEST_ASSERT_EQUAL_HEX8(BAD_REQUEST, exchange(request));
+
+    TEST_ASSERT_EQUAL_UINT16(version, scheduleVersion());
+    TEST_ASSERT_EQUAL_UINT32(writes, mockNvs.writes);
+    expectStored();
+}
+
+int main() {
+    startTasks(); // Queues only: the tasks never run on the host
+    registerTransport(link);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_update_writes_one_page);
+    RUN_TEST(test_inserts_are_stored);
+    RUN_TEST(test_delete_onto_page_boundary);
+    RUN_TEST(test_edits_in_one_frame);
+    RUN_TEST(test_out_of_range_index_applies_nothing);
+    return UNITY_END();
+}
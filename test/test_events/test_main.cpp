@@ -0,0 +1,169 @@
+#include <unity.h>
+
+#include "global_vars.h"
+#include "loopback_transport.h"
+#include "server.h"
+#include "tasks.h"
+#include "utils.h"
+
+// ============================================================================
+//   Pushed Events
+//   A client subscribes over the loopback transport, then serviceEvents()
+//   runs as the protocol task would between requests. Queued events beyond
+//   EVENT_QUEUE_LENGTH must be reported with EVENT_LOST; clock and state
+//   must come as their latest value, not as a backlog.
+// ============================================================================
+static LoopbackTransport link;
+
+struct Pushed {
+    byte type;
+    byte data[3];
+    int length;
+};
+
+static void subscribe(byte mask) {
+    const byte request[] = {2, SUBSCRIBE, mask};
+    byte payload[8];
+
+    link.send(request, sizeof(request));
+    execRequest();
+    TEST_ASSERT_EQUAL_INT(2, takeFrame(link, PROTOCOL_V1, payload));
+    TEST_ASSERT_EQUAL_HEX8(SUBSCRIBE, payload[0]);
+    TEST_ASSERT_EQUAL_HEX8(mask, payload[1]);
+}
+
+// Take one EVENT frame, false if none is left
+static bool takePushed(Pushed &pushed) {
+    byte payload[16];
+    int length = takeFrame(link, PROTOCOL_V1, payload);
+    if (length < 0) return false;
+
+    TEST_ASSERT_GREATER_OR_EQUAL(2, length);
+    TEST_ASSERT_EQUAL_HEX8(EVENT, payload[0]);
+    pushed.type = payload[1];
+    pushed.length = length - 2;
+    memcpy(pushed.data, payload + 2, min(pushed.length, 3));
+    return true;
+}
+
+void setUp() {
+    memset(&eeprom, 0, sizeof(eeprom));
+    eeprom.state = 1;
+
+    Wire.failing = false;
+    Wire.rtc.set(2026, 10, 17, 7, 9, 15, 0);
+    resyncClock();
+    serviceClock();
+
+    link.reset();
+    subscribe(0);
+    Event event;
+    while (takeEvent(event)) {}
+    serviceEvents(); // Drops what an earlier test left
+    link.discard();
+}
+
+void tearDown() {}
+
+// The queue keeps the first EVENT_QUEUE_LENGTH events, the rest are counted
+void test_full_queue_reports_lost_events() {
+    const int posted = EVENT_QUEUE_LENGTH + 5;
+    subscribe(SUBSCRIBE_RELAY);
+
+    for (int i = 0; i < posted; i++) postEvent(EVENT_RELAY, i & 1);
+    serviceEvents();
+
+    Pushed pushed;
+    for (int i = 0; i < EVENT_QUEUE_LENGTH; i++) {
+        TEST_ASSERT_TRUE(takePushed(pushed));
+        TEST_ASSERT_EQUAL_UINT8(EVENT_RELAY, pushed.type);
+        TEST_ASSERT_EQUAL_UINT8(i & 1, pushed.data[0]);
+    }
+    TEST_ASSERT_TRUE(takePushed(pushed));
+    TEST_ASSERT_EQUAL_UINT8(EVENT_LOST, pushed.type);
+    TEST_ASSERT_EQUAL_INT(1, pushed.length);
+    TEST_ASSERT_EQUAL_UINT8(posted - EVENT_QUEUE_LENGTH, pushed.data[0]);
+    TEST_ASSERT_FALSE(takePushed(pushed));
+
+    // The count was reset when it was reported
+    postEvent(EVENT_RELAY, 1);
+    serviceEvents();
+    TEST_ASSERT_TRUE(takePushed(pushed));
+    TEST_ASSERT_EQUAL_UINT8(EVENT_RELAY, pushed.type);
+    TEST_ASSERT_FALSE(takePushed(pushed));
+}
+
+// EVENT_LOST saturates at 255
+void test_lost_count_saturates() {
+    subscribe(SUBSCRIBE_ALARMS);
+
+    for (int i = 0; i < EVENT_QUEUE_LENGTH + 300; i++) postEvent(EVENT_ALARM_FIRED, i);
+    serviceEvents();
+
+    Pushed pushed, last = {};
+    int count = 0;
+    while (takePushed(pushed)) {
+        last = pushed;
+        count++;
+    }
+    TEST_ASSERT_EQUAL_INT(EVENT_QUEUE_LENGTH + 1, count);
+    TEST_ASSERT_EQUAL_UINT8(EVENT_LOST, last.type);
+    TEST_ASSERT_EQUAL_UINT8(255, last.data[0]);
+}
+
+// Seconds that passed while the client lagged are pushed as one event
+void test_clock_events_merge_to_the_latest() {
+    Pushed pushed;
+
+    subscribe(SUBSCRIBE_CLOCK_SECOND);
+    serviceEvents();
+    TEST_ASSERT_TRUE(takePushed(pushed));
+    TEST_ASSERT_EQUAL_UINT8(EVENT_CLOCK, pushed.type);
+    TEST_ASSERT_FALSE(takePushed(pushed));
+
+    ticks = ticks + 5000;
+    serviceEvents();
+    ClockTime now = getClock();
+    TEST_ASSERT_TRUE(takePushed(pushed));
+    TEST_ASSERT_EQUAL_UINT8(EVENT_CLOCK, pushed.type);
+    TEST_ASSERT_EQUAL_INT(3, pushed.length);
+    TEST_ASSERT_EQUAL_UINT8(now.hour, pushed.data[0]);
+    TEST_ASSERT_EQUAL_UINT8(now.minute, pushed.data[1]);
+    TEST_ASSERT_EQUAL_UINT8(now.second, pushed.data[2]);
+    TEST_ASSERT_FALSE(takePushed(pushed));
+
+    // Nothing new within the same second
+    serviceEvents();
+    TEST_ASSERT_FALSE(takePushed(pushed));
+}
+
+void test_state_events_merge_to_the_latest() {
+    Pushed pushed;
+
+    subscribe(SUBSCRIBE_STATE);
+    serviceEvents();
+    TEST_ASSERT_TRUE(takePushed(pushed));
+    TEST_ASSERT_EQUAL_UINT8(EVENT_STATE, pushed.type);
+    TEST_ASSERT_EQUAL_UINT8(1, pushed.data[0]);
+
+    eeprom.state = 0;
+    eeprom.state = 1;
+    eeprom.state = 0;
+    serviceEvents();
+    TEST_ASSERT_TRUE(takePushed(pushed));
+    TEST_ASSERT_EQUAL_UINT8(EVENT_STATE, pushed.type);
+    TEST_ASSERT_EQUAL_UINT8(0, pushed.data[0]);
+    TEST_ASSERT_FALSE(takePushed(pushed));
+}
+
+int main() {
+    startTasks(); // Queues only: the tasks never run on the host
+    registerTransport(link);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_full_queue_reports_lost_events);
+    RUN_TEST(test_lost_count_saturates);
+    RUN_TEST(test_clock_events_merge_to_the_latest);
+    RUN_TEST(test_state_events_merge_to_the_latest);
+    return UNITY_END();
+}
@@ -0,0 +1,212 @@
+#include <unity.h>
+
+#include "display.h"
+#include "global_vars.h"
+#include "tasks.h"
+#include "utils.h"
+
+// ============================================================================
+//   Screen Snapshots
+//   The LCD is the virtual HD44780 of test/native/LiquidCrystal.h: each
+//   screen is rendered through the real framebuffer and LCD task code, then
+//   the 16x2 window and CGRAM are compared with the expected screen. Bus
+//   time per frame is reported, so a rendering change shows its cost.
+// ============================================================================
+
+// The baseline cleared the LCD and rewrote every cell of an alarm page:
+// clear, home and 31 more transactions
+#define BASELINE_ALARM_PAGE_US (33 * HD44780_TRANSFER_US + 2 * HD44780_CLEAR_US)
+
+void setup(); // main.cpp
+
+extern byte thermometre[], next[], prev[], line[], on[], off[]; // main.cpp
+
+// Render the latest frame as the LCD task does; returns its bus time (µs)
+static uint32_t render() {
+    uint32_t start = lcd.busMicros;
+    serviceLcd();
+    return lcd.busMicros - start;
+}
+
+// Check one row of the window. Custom characters are given by their code.
+static void expectRow(byte row, const byte expected[LCD_COLS]) {
+    char message[40];
+    for (byte col = 0; col < LCD_COLS; col++) {
+        snprintf(message, sizeof(message), "row %u, col %u", row, col);
+        TEST_ASSERT_EQUAL_HEX8_MESSAGE(expected[col], lcd.at(col, row), message);
+    }
+}
+
+static void expectRow(byte row, const char *expected) {
+    expectRow(row, (const byte *)expected);
+}
+
+static void reportFrame(const char *name, uint32_t micros) {
+    char text[80];
+    snprintf(text, sizeof(text), "%s: %u us on the bus", name, (unsigned)micros);
+    TEST_MESSAGE(text);
+}
+
+void setUp() {
+    memset(&eeprom, 0, sizeof(eeprom));
+    eeprom.state = 1;
+    eeprom.alarmCount = 3;
+    eeprom.alarms[0] = packAlarm(8, 5, 5, 0xFF);         // Every day, active
+    eeprom.alarms[1] = packAlarm(17, 30, 12, 0x7E);      // Mon-Sat, inactive
+    eeprom.alarms[2] = packAlarm(23, 59, 1, 0x83);       // Sat and Sun, active
+    compileSchedule();
+
+    Wire.rtc.temperature = 21.25f;
+    Wire.rtc.set(2026, 10, 18, 1, 12, 34, 56);
+    resyncClock();
+    serviceClock();
+
+    currentMenu = HOME;
+    initHome();
+    render();
+}
+
+void tearDown() {}
+
+// setup() loads the custom characters and leaves DDRAM addressing on
+void test_setup_loads_custom_characters() {
+    struct { byte code; const byte *pattern; } glyphs[] = {
+        {THERMOMETER_CHAR, thermometre}, {NEXT_CHAR, next}, {PREV_CHAR, prev},
+        {LINE_CHAR, line}, {ON_CHAR, on}, {OFF_CHAR, off},
+    };
+
+    for (auto &glyph : glyphs) {
+        TEST_ASSERT_EQUAL_MEMORY(glyph.pattern, lcd.glyph(glyph.code), 8);
+        TEST_ASSERT_EQUAL_MEMORY(glyph.pattern, lcd.glyph(glyph.code + 8), 8); // Same character
+    }
+    TEST_ASSERT_FALSE(lcd.addressingCgram());
+}
+
+// The emulator itself: data after createChar() lands in CGRAM, as on the chip
+void test_emulator_addressing() {
+    LiquidCrystal chip(RS, EN, D4, D5, D6, D7);
+    byte pattern[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+    chip.begin(16, 2);
+    chip.createChar(3, pattern);
+    chip.write('x');                       // Row 0 of character 4
+    TEST_ASSERT_EQUAL_HEX8('x' & 0x1F, chip.glyph(4)[0]);
+    TEST_ASSERT_EQUAL_HEX8(' ', chip.at(0, 0));
+
+    chip.setCursor(39, 0);
+    chip.print("ab");                      // Row 0 continues on row 1
+    TEST_ASSERT_EQUAL_HEX8('b', chip.at(0, 1));
+    TEST_ASSERT_EQUAL_UINT32(4 + 1 + 8 + 1 + 1 + 2, chip.transactions());
+    TEST_ASSERT_EQUAL_UINT32(chip.transactions() * HD44780_TRANSFER_US + HD44780_CLEAR_US, chip.busMicros);
+}
+
+void test_home_screen() {
+    const byte bottom[LCD_COLS] = {'1', '2', ':', '3', '4', ':', '5', '6', ' ', ON_CHAR, ' ',
+                                   THERMOMETER_CHAR, '2', '1', DEGRE_CHAR, 'C'};
+
+    invalidateFrame();
+    initHome();
+    uint32_t micros = render();
+
+    expectRow(0, " Sun,18/10/2026 ");
+    expectRow(1, bottom);
+    reportFrame("home screen, full", micros);
+}
+
+void test_home_refresh() {
+    ticks = ticks + 1000;
+    refreshHome();
+    uint32_t micros = render();
+
+    expectRow(0, " Sun,18/10/2026 ");
+    TEST_ASSERT_EQUAL_HEX8('5', lcd.at(6, 1));
+    TEST_ASSERT_EQUAL_HEX8('7', lcd.at(7, 1));
+    TEST_ASSERT_LESS_THAN(HD44780_CLEAR_US, micros);
+    reportFrame("home refresh, one second", micros);
+}
+
+void test_home_refresh_at_midnight() {
+    Wire.rtc.set(2026, 12, 31, 5, 23, 59, 59);
+    resyncClock();
+    serviceClock();
+    refreshHome();
+    render();
+
+    ticks = ticks + 1000;
+    serviceClock();
+    refreshHome();
+    uint32_t micros = render();
+
+    expectRow(0, " Fri,01/01/2027 ");
+    for (byte col = 0; col < 8; col++) TEST_ASSERT_EQUAL_HEX8("00:00:00"[col], lcd.at(col, 1));
+    reportFrame("home refresh, new year", micros);
+}
+
+void test_alarm_pages() {
+    const byte first[2][LCD_COLS] = {
+        {'n', DEGRE_CHAR, '0', '0', '0', '1', ' ', '0', '8', ':', '0', '5', ' ', '0', '5', 's'},
+        {'M', 'T', 'W', 'T', 'F', 'S', 'S', ' ', ' ', ON_CHAR, ' ', ' ', ' ', ' ', ' ', NEXT_CHAR},
+    };
+    const byte middle[2][LCD_COLS] = {
+        {'n', DEGRE_CHAR, '0', '0', '0', '2', ' ', '1', '7', ':', '3', '0', ' ', '1', '2', 's'},
+        {'M', 'T', 'W', 'T', 'F', 'S', '_', ' ', ' ', OFF_CHAR, ' ', ' ', ' ', PREV_CHAR, ' ', NEXT_CHAR},
+    };
+    const byte last[2][LCD_COLS] = {
+        {'n', DEGRE_CHAR, '0', '0', '0', '3', ' ', '2', '3', ':', '5', '9', ' ', '0', '1', 's'},
+        {'_', '_', '_', '_', '_', 'S', 'S', ' ', ' ', ON_CHAR, ' ', ' ', ' ', PREV_CHAR, ' ', ' '},
+    };
+    const byte (*pages[3])[LCD_COLS] = {first, middle, last};
+
+    currentMenu = ALARMS;
+    for (alarmIndex = 0; alarmIndex < 3; alarmIndex++) {
+        displayAlarm();
+        uint32_t micros = render();
+
+        expectRow(0, pages[alarmIndex][0]);
+        expectRow(1, pages[alarmIndex][1]);
+        TEST_ASSERT_LESS_THAN(BASELINE_ALARM_PAGE_US, micros); // Never cleared
+        reportFrame(alarmIndex == 0 ? "alarm page, from home" : "alarm page, next", micros);
+    }
+
+    char text[80];
+    snprintf(text, sizeof(text), "alarm page before: %u us on the bus", (unsigned)BASELINE_ALARM_PAGE_US);
+    TEST_MESSAGE(text);
+}
+
+void test_relay_alarm_page() {
+    const byte top[LCD_COLS] = {'n', DEGRE_CHAR, '0', '0', '0', '2', ' ', '1', '7', ':', '3', '0', ' ', 'O', 'F', 'F'};
+
+    eeprom.programType = 1;
+    compileSchedule();
+    currentMenu = ALARMS;
+    alarmIndex = 1;
+    displayAlarm();
+    render();
+    expectRow(0, top);
+    eeprom.programType = 0;
+    compileSchedule();
+}
+
+void test_message_over_screen() {
+    showMessage("  SETTINGS SET  ", "   SUCCESSFULLY ");
+    uint32_t micros = render();
+
+    expectRow(0, "  SETTINGS SET  ");
+    expectRow(1, "   SUCCESSFULLY ");
+    reportFrame("message", micros);
+}
+
+int main() {
+    setup(); // Real boot: LCD init, custom characters, home screen
+
+    UNITY_BEGIN();
+    RUN_TEST(test_setup_loads_custom_characters);
+    RUN_TEST(test_emulator_addressing);
+    RUN_TEST(test_home_screen);
+    RUN_TEST(test_home_refresh);
+    RUN_TEST(test_home_refresh_at_midnight);
+    RUN_TEST(test_alarm_pages);
+    RUN_TEST(test_relay_alarm_page);
+    RUN_TEST(test_message_over_screen);
+    return UNITY_END();
+}
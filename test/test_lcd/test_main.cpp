@@ -0,0 +1,119 @@
+#include <unity.h>
+
+#include "display.h"
+#include "global_vars.h"
+#include "utils.h"
+
+// ============================================================================
+//   Shadow Framebuffer
+//   HD44780 bus transactions (instructions + data bytes) per screen update,
+//   against the baseline that printed each field with its own calls:
+//   → home refresh: cursor + 2 digits for the seconds every second, the
+//     same again for the minutes every minute
+//   → alarm page: clear, home, 2-3 cursors and every character (middle page)
+// ============================================================================
+#define BASELINE_HOME_MINUTE (60 * 3 + 3)
+#define BASELINE_ALARM_PAGE 33
+
+static uint32_t lastTransactions;
+
+// Transactions sent since the last call
+static uint32_t busDelta() {
+    uint32_t delta = lcd.transactions() - lastTransactions;
+    lastTransactions = lcd.transactions();
+    return delta;
+}
+
+// Draw the latest frame, as the LCD task does
+static uint32_t drawn() {
+    serviceLcd();
+    return busDelta();
+}
+
+void setUp() {
+    memset(&eeprom, 0, sizeof(eeprom));
+    eeprom.state = 1;
+    eeprom.alarmCount = 40;
+    for (uint16_t i = 0; i < 40; i++) eeprom.alarms[i] = packAlarm(6 + i % 12, 5 * (i % 12), 1 + i % 30, 0x55 | (i & 2));
+    compileSchedule();
+
+    Wire.rtc.set(2026, 10, 18, 1, 12, 0, 0);
+    resyncClock();
+    serviceClock();
+
+    currentMenu = HOME;
+    invalidateFrame();
+    initHome();
+    drawn();
+}
+
+void tearDown() {}
+
+void test_first_frame_draws_every_cell_once() {
+    invalidateFrame();
+    initHome();
+    TEST_ASSERT_EQUAL_UINT32(LCD_ROWS + LCD_ROWS * LCD_COLS, drawn()); // One cursor set per row
+}
+
+void test_unchanged_frame_sends_nothing() {
+    refreshHome();
+    TEST_ASSERT_EQUAL_UINT32(0, drawn());
+}
+
+void test_home_refresh_for_a_minute() {
+    uint32_t total = 0;
+
+    for (int i = 0; i < 60; i++) {
+        ticks = ticks + 1000;
+        refreshHome();
+        total += drawn();
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(BASELINE_HOME_MINUTE, total);
+
+    char text[100];
+    snprintf(text, sizeof(text), "home refresh: %u bus transactions per minute, %u before",
+             (unsigned)total, BASELINE_HOME_MINUTE);
+    TEST_MESSAGE(text);
+}
+
+// 12:00:59 -> 12:01:00: the three changed digits go out as one run
+void test_minute_rollover_is_one_run() {
+    ticks = ticks + 59000;
+    refreshHome();
+    drawn();
+
+    uint32_t commands = lcd.commands;
+    ticks = ticks + 1000;
+    refreshHome();
+    TEST_ASSERT_EQUAL_UINT32(1 + 4, drawn()); // "1:00", the ':' rewritten instead of a cursor set
+    TEST_ASSERT_EQUAL_UINT32(commands + 1, lcd.commands);
+}
+
+void test_alarm_page_change() {
+    currentMenu = ALARMS;
+    alarmIndex = 9;
+    displayAlarm();
+    drawn();
+
+    uint32_t commands = lcd.commands;
+    alarmIndex = 10;
+    displayAlarm();
+    uint32_t sent = drawn();
+    TEST_ASSERT_LESS_THAN(BASELINE_ALARM_PAGE, sent);
+    TEST_ASSERT_LESS_OR_EQUAL(commands + LCD_ROWS * 3, lcd.commands); // No clear, few cursor sets
+
+    char text[100];
+    snprintf(text, sizeof(text), "alarm page change: %u bus transactions, %u before",
+             (unsigned)sent, BASELINE_ALARM_PAGE);
+    TEST_MESSAGE(text);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_frame_draws_every_cell_once);
+    RUN_TEST(test_unchanged_frame_sends_nothing);
+    RUN_TEST(test_home_refresh_for_a_minute);
+    RUN_TEST(test_minute_rollover_is_one_run);
+    RUN_TEST(test_alarm_page_change);
+    return UNITY_END();
+}
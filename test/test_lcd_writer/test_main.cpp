@@ -0,0 +1,148 @@
+#include <unity.h>
+
+#include "display.h"
+#include "global_vars.h"
+#include "loopback_transport.h"
+#include "schedule.h"
+#include "server.h"
+#include "tasks.h"
+#include "utils.h"
+
+// ============================================================================
+//   Asynchronous LCD Writer
+//   The LCD is made slow: every bus transaction takes 1 ms of simulated
+//   time. Only the LCD task may pay for it; the alarm and protocol paths
+//   and flushFrame() must not move the clock. The baseline drew inline,
+//   so the alarm loop waited for every transaction.
+// ============================================================================
+#define LCD_TRANSACTION_MS 1
+
+extern char glass[LCD_ROWS][LCD_COLS]; // display.cpp
+
+static LoopbackTransport link;
+static void (*midFrame)(); // Run once, on the 4th transaction of a frame
+static uint32_t frameTransactions;
+
+static void slowLcd() {
+    ticks = ticks + LCD_TRANSACTION_MS;
+    if (++frameTransactions == 4 && midFrame != NULL) midFrame();
+}
+
+static bool takeEventType(byte type) {
+    Event event;
+    bool found = false;
+    while (takeEvent(event)) found |= event.type == type;
+    return found;
+}
+
+void setUp() {
+    memset(&eeprom, 0, sizeof(eeprom));
+    eeprom.state = 1;
+    eeprom.alarmCount = 1;
+    eeprom.alarms[0] = packAlarm(8, 0, 5, 0xFF);
+    compileSchedule();
+
+    Wire.rtc.set(2026, 10, 18, 1, 7, 59, 0);
+    resyncClock();
+    serviceClock();
+
+    lcd.onTransaction = NULL;
+    midFrame = NULL;
+    currentMenu = HOME;
+    invalidateFrame();
+    initHome();
+    serviceLcd();
+    lcd.onTransaction = slowLcd;
+    frameTransactions = 0;
+}
+
+void tearDown() {
+    lcd.onTransaction = NULL;
+}
+
+void test_flush_does_not_wait_on_lcd() {
+    uint32_t start = ticks;
+    uint32_t sent = lcd.transactions();
+
+    for (int i = 0; i < 100; i++) {
+        invalidateFrame();
+        initHome();
+    }
+    TEST_ASSERT_EQUAL_UINT32(start, ticks);
+    TEST_ASSERT_EQUAL_UINT32(sent, lcd.transactions());
+
+    serviceLcd(); // The LCD task pays for the frame, once
+    TEST_ASSERT_EQUAL_UINT32(LCD_ROWS + LCD_ROWS * LCD_COLS, lcd.transactions() - sent);
+}
+
+// Alarm onsets with a full redraw pending: no jitter from the display
+void test_alarm_path_does_not_wait_on_lcd() {
+    uint32_t sleep = runScheduler();
+    uint32_t sent = lcd.transactions();
+    uint32_t jitter = 0;
+
+    for (int i = 0; i < 600; i++) {
+        invalidateFrame();
+        refreshHome(); // A frame is always waiting for the LCD task
+
+        ticks = ticks + sleep;
+        uint32_t woken = ticks;
+        sleep = runScheduler();
+        jitter = max(jitter, ticks - woken);
+    }
+    TEST_ASSERT_TRUE(takeEventType(EVENT_ALARM_FIRED));
+    TEST_ASSERT_EQUAL_UINT32(0, jitter);
+    TEST_ASSERT_EQUAL_UINT32(0, getOnsetLatency());
+    TEST_ASSERT_EQUAL_UINT32(sent, lcd.transactions());
+
+    char text[100];
+    snprintf(text, sizeof(text), "alarm loop jitter: %u ms with a %u ms/transaction LCD, up to %u ms before",
+             (unsigned)jitter, LCD_TRANSACTION_MS, (unsigned)((LCD_ROWS + LCD_ROWS * LCD_COLS) * LCD_TRANSACTION_MS));
+    TEST_MESSAGE(text);
+}
+
+void test_protocol_does_not_wait_on_lcd() {
+    const byte request[] = {1, GET_STATE};
+    byte payload[8];
+    uint32_t start = ticks;
+    uint32_t sent = lcd.transactions();
+
+    for (int i = 0; i < 100; i++) {
+        link.send(request, sizeof(request));
+        execRequest();
+        TEST_ASSERT_EQUAL_INT(2, takeFrame(link, PROTOCOL_V1, payload));
+    }
+    TEST_ASSERT_EQUAL_UINT32(start, ticks);
+    TEST_ASSERT_EQUAL_UINT32(sent, lcd.transactions());
+}
+
+// Midway through the home screen a message is flushed: the LCD task drops
+// the rest of the home screen and draws the message
+static void flushMessage() {
+    showMessage(" TRANSFERRING.. ", "                ");
+}
+
+void test_newer_frame_replaces_older() {
+    uint32_t sent = lcd.transactions();
+
+    invalidateFrame();
+    initHome();
+    midFrame = flushMessage;
+    serviceLcd();
+
+    TEST_ASSERT_EQUAL_MEMORY(" TRANSFERRING.. ", glass[0], LCD_COLS);
+    TEST_ASSERT_EQUAL_MEMORY("                ", glass[1], LCD_COLS);
+    TEST_ASSERT_LESS_THAN(2 * (LCD_ROWS + LCD_ROWS * LCD_COLS), lcd.transactions() - sent);
+}
+
+int main() {
+    startTasks(); // Queues only: the tasks never run on the host
+    registerTransport(link);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_flush_does_not_wait_on_lcd);
+    RUN_TEST(test_alarm_path_does_not_wait_on_lcd);
+    RUN_TEST(test_protocol_does_not_wait_on_lcd);
+    RUN_TEST(test_newer_frame_replaces_older);
+    return UNITY_END();
+}
@@ -0,0 +1,131 @@
+#include <chrono>
+#include <unity.h>
+
+#include "global_vars.h"
+#include "loopback_transport.h"
+#include "server.h"
+#include "tasks.h"
+
+// ============================================================================
+//   Incremental Frame Parser
+//   Requests go through the loopback transport in chunks of any size. The
+//   parser must answer the same bytes however the stream is split, pull
+//   its input in bulk reads, and its cost is reported per byte and frame.
+// ============================================================================
+#define FRAMES 1000
+
+static LoopbackTransport link;
+static byte stream[FRAMES * 3];
+static size_t streamLength;
+static uint32_t seed;
+
+static uint32_t nextRandom() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+// GET_STATE, GET_PROGRAM_TYPE, GET_ALARMS_PAGE and GET_ALARMS, in random order
+static void buildStream() {
+    const byte requests[4][3] = {{1, GET_STATE}, {1, GET_PROGRAM_TYPE}, {2, GET_ALARMS_PAGE, 1}, {1, GET_ALARMS}};
+
+    seed = 0xF00D;
+    streamLength = 0;
+    for (int i = 0; i < FRAMES; i++) {
+        const byte *request = requests[nextRandom() % 4];
+        memcpy(stream + streamLength, request, 1 + request[0]);
+        streamLength += 1 + request[0];
+    }
+}
+
+// Feed the stream in chunks of 1 to `maxChunk` bytes (0: all at once),
+// collecting the responses. Returns their length.
+static size_t feed(size_t maxChunk, byte *responses, size_t room) {
+    size_t length = 0;
+
+    link.reset();
+    for (size_t sent = 0; sent < streamLength;) {
+        size_t n = maxChunk == 0 ? streamLength : 1 + nextRandom() % maxChunk;
+        n = min(n, streamLength - sent);
+        link.send(stream + sent, n);
+        sent += n;
+
+        do {
+            execRequest();
+            for (int c; (c = link.receive()) >= 0 && length < room;) responses[length++] = c;
+        } while (link.available() > 0);
+    }
+    return length;
+}
+
+void setUp() {
+    memset(&eeprom, 0, sizeof(eeprom));
+    eeprom.state = 1;
+    eeprom.alarmCount = 20; // All the responses of a stream fit in the link
+    for (uint16_t i = 0; i < 20; i++) eeprom.alarms[i] = packAlarm(i % 24, i, 1 + i % 30, 0xFF);
+    compileSchedule();
+    buildStream();
+}
+
+void tearDown() {}
+
+void test_responses_do_not_depend_on_fragmentation() {
+    static byte whole[1 << 20], split[1 << 20];
+    size_t wholeLength = feed(0, whole, sizeof(whole));
+    TEST_ASSERT_GREATER_THAN(FRAMES * 3, wholeLength);
+
+    const size_t chunks[] = {1, 2, 3, 7, 64, 1000};
+    for (size_t chunk : chunks) {
+        size_t length = feed(chunk, split, sizeof(split));
+        TEST_ASSERT_EQUAL_UINT32(wholeLength, length);
+        TEST_ASSERT_EQUAL_MEMORY(whole, split, length);
+    }
+}
+
+// Whole chunks are pulled with a few bulk reads, not byte by byte
+void test_input_is_read_in_bulk() {
+    link.reset();
+    link.send(stream, streamLength);
+    uint32_t reads = link.reads;
+
+    execRequest();
+    link.discard();
+    TEST_ASSERT_EQUAL_UINT32(0, link.available());
+    TEST_ASSERT_LESS_OR_EQUAL(2, link.reads - reads);
+}
+
+void test_parser_throughput() {
+    const int rounds = 200;
+    uint64_t nanos = 0;
+    size_t bytes = 0;
+
+    for (int round = 0; round < rounds; round++) {
+        link.reset();
+        for (size_t sent = 0; sent < streamLength; sent += 256) {
+            link.send(stream + sent, min<size_t>(256, streamLength - sent)); // One SPP packet
+            auto start = std::chrono::steady_clock::now();
+            execRequest();
+            nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            link.discard();
+        }
+        bytes += streamLength;
+    }
+
+    char text[120];
+    snprintf(text, sizeof(text), "parser: %.1f MB/s, %.0f ns per frame (responses included)",
+             bytes / (nanos / 1e9) / 1e6, (double)nanos / (rounds * FRAMES));
+    TEST_MESSAGE(text);
+    TEST_ASSERT_GREATER_THAN(0, bytes);
+}
+
+int main() {
+    startTasks(); // Queues only: the tasks never run on the host
+    registerTransport(link);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_responses_do_not_depend_on_fragmentation);
+    RUN_TEST(test_input_is_read_in_bulk);
+    RUN_TEST(test_parser_throughput);
+    return UNITY_END();
+}
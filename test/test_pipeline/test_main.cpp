@@ -0,0 +1,219 @@
+#include <deque>
+#include <unity.h>
+
+#include "global_vars.h"
+#include "loopback_transport.h"
+#include "server.h"
+#include "tasks.h"
+
+// ============================================================================
+//   Pipelined v3 Requests
+//   Every v3 response carries the sequence number of its request and a
+//   CRC-16. A simulated SPP link (one-way latency, serial bandwidth) shows
+//   the gain of keeping several requests outstanding over stop-and-wait.
+// ============================================================================
+#define LINK_BYTES_PER_MS 20 // ~160 kbit/s of SPP payload
+
+static LoopbackTransport link;
+static LoopbackTransport client; // Client end of the simulated link
+
+struct Response {
+    int length;
+    byte seq;
+    bool crcOk;
+    byte payload[256];
+};
+
+static void sendV3(byte seq, const byte *payload, uint16_t length) {
+    byte frame[300];
+    link.send(frame, buildFrame(frame, PROTOCOL_V3, seq, payload, length));
+}
+
+static bool takeResponse(Response &response) {
+    bool more;
+    response.length = takeFrame(link, PROTOCOL_V3, response.payload, &response.seq, &more, &response.crcOk);
+    return response.length >= 0;
+}
+
+// Drop the link, then CONNECTED with the v3 magic, in v1 framing
+static void connectV3() {
+    const byte hello[] = {2, CONNECTED, PROTOCOL_V3_MAGIC};
+    byte payload[8];
+
+    link.attached = false;
+    execRequest(); // Back to v1
+    link.attached = true;
+    link.reset();
+    link.send(hello, sizeof(hello));
+    execRequest();
+    TEST_ASSERT_EQUAL_INT(2, takeFrame(link, PROTOCOL_V1, payload));
+    TEST_ASSERT_EQUAL_HEX8(SET_PROTOCOL_VERSION, payload[0]);
+    TEST_ASSERT_EQUAL_UINT8(PROTOCOL_V3, payload[1]);
+}
+
+void setUp() {
+    memset(&eeprom, 0, sizeof(eeprom));
+    eeprom.state = 1;
+    eeprom.alarmCount = MAX_ALARMS;
+    for (uint16_t i = 0; i < MAX_ALARMS; i++) eeprom.alarms[i] = packAlarm(i % 24, i % 60, 1 + i % 30, 0xFF);
+    compileSchedule();
+    connectV3();
+}
+
+void tearDown() {}
+
+void test_responses_echo_sequence_numbers() {
+    const byte request[] = {GET_STATE};
+    Response response;
+
+    for (byte seq = 10; seq < 18; seq++) sendV3(seq, request, sizeof(request));
+    execRequest();
+
+    for (byte seq = 10; seq < 18; seq++) {
+        TEST_ASSERT_TRUE(takeResponse(response));
+        TEST_ASSERT_EQUAL_UINT8(seq, response.seq);
+        TEST_ASSERT_TRUE(response.crcOk);
+        TEST_ASSERT_EQUAL_INT(2, response.length);
+        TEST_ASSERT_EQUAL_HEX8(SET_STATE, response.payload[0]);
+    }
+    TEST_ASSERT_FALSE(takeResponse(response));
+}
+
+// Only the corrupted frame is dropped, and its error says which one it was
+void test_crc_error_names_the_corrupted_frame() {
+    const byte request[] = {GET_PROGRAM_TYPE};
+    byte frame[16];
+    Response response;
+
+    sendV3(1, request, sizeof(request));
+    size_t length = buildFrame(frame, PROTOCOL_V3, 2, request, sizeof(request));
+    frame[3] ^= 0x40;
+    link.send(frame, length);
+    sendV3(3, request, sizeof(request));
+    execRequest();
+
+    const byte expected[3] = {SET_PROGRAM_TYPE, CRC_ERROR, SET_PROGRAM_TYPE};
+    for (byte seq = 1; seq <= 3; seq++) {
+        TEST_ASSERT_TRUE(takeResponse(response));
+        TEST_ASSERT_EQUAL_UINT8(seq, response.seq);
+        TEST_ASSERT_TRUE(response.crcOk);
+        TEST_ASSERT_EQUAL_HEX8(expected[seq - 1], response.payload[0]);
+    }
+}
+
+void test_bad_request_names_its_frame() {
+    const byte truncated[] = {GET_ALARMS_PAGE}; // Page number missing
+    const byte request[] = {GET_STATE};
+    Response response;
+
+    sendV3(7, truncated, sizeof(truncated));
+    sendV3(8, request, sizeof(request));
+    execRequest();
+
+    TEST_ASSERT_TRUE(takeResponse(response));
+    TEST_ASSERT_EQUAL_UINT8(7, response.seq);
+    TEST_ASSERT_EQUAL_HEX8(BAD_REQUEST, response.payload[0]);
+    TEST_ASSERT_TRUE(takeResponse(response));
+    TEST_ASSERT_EQUAL_UINT8(8, response.seq);
+    TEST_ASSERT_EQUAL_HEX8(SET_STATE, response.payload[0]);
+}
+
+// ============================================================================
+//   Simulated Link
+//   Millisecond steps. Each direction sends one byte stream at
+//   LINK_BYTES_PER_MS; a frame arrives `latency` ms after its last byte.
+// ============================================================================
+struct Flight {
+    uint32_t arrival;
+    byte frame[300];
+    size_t length;
+};
+
+struct Direction {
+    std::deque<Flight> flights;
+    uint32_t busyUntil;         // The last frame is on the wire until then
+
+    void send(uint32_t now, uint32_t latency, const byte *frame, size_t length) {
+        Flight flight;
+        busyUntil = max(busyUntil, now) + (length + LINK_BYTES_PER_MS - 1) / LINK_BYTES_PER_MS;
+        flight.arrival = busyUntil + latency;
+        memcpy(flight.frame, frame, length);
+        flight.length = length;
+        flights.push_back(flight);
+    }
+
+    bool arrived(uint32_t now, Flight &flight) {
+        if (flights.empty() || flights.front().arrival > now) return false;
+        flight = flights.front();
+        flights.pop_front();
+        return true;
+    }
+};
+
+// Read every alarm page with up to `window` requests outstanding.
+// Returns the simulated time taken (ms).
+static uint32_t readAllPages(uint32_t latency, byte window) {
+    const byte pages = MAX_ALARMS / ALARMS_PAGE_SIZE;
+    Direction up = {}, down = {};
+    Flight flight;
+
+    client.reset();
+    Response response;
+    byte sent = 0, received = 0;
+
+    for (uint32_t now = 0;; now++) {
+        while (sent < pages && sent - received < window) {
+            byte request[2] = {GET_ALARMS_PAGE, sent};
+            byte frame[16];
+            up.send(now, latency, frame, buildFrame(frame, PROTOCOL_V3, sent, request, sizeof(request)));
+            sent++;
+        }
+
+        while (up.arrived(now, flight)) link.send(flight.frame, flight.length);
+        execRequest();
+        while (link.received() > 0) {
+            byte frame[300];
+            size_t length = link.received();
+            for (size_t i = 0; i < length; i++) frame[i] = link.receive();
+            down.send(now, latency, frame, length);
+        }
+
+        while (down.arrived(now, flight)) {
+            client.write(flight.frame, flight.length);
+            while (takeFrame(client, PROTOCOL_V3, response.payload, &response.seq, NULL, &response.crcOk) >= 0) {
+                TEST_ASSERT_TRUE(response.crcOk);
+                TEST_ASSERT_EQUAL_UINT8(received, response.seq); // In order, tagged
+                TEST_ASSERT_EQUAL_UINT8(received, response.payload[1]);
+                received++;
+            }
+        }
+        if (received == pages) return now;
+    }
+}
+
+void test_pipelining_at_link_latency() {
+    const uint32_t latencies[] = {20, 50};
+
+    for (uint32_t latency : latencies) {
+        uint32_t stopAndWait = readAllPages(latency, 1);
+        uint32_t pipelined = readAllPages(latency, 8);
+        TEST_ASSERT_LESS_THAN(stopAndWait / 3, pipelined);
+
+        char text[120];
+        snprintf(text, sizeof(text), "%u ms latency, %u alarm pages: %u ms stop-and-wait, %u ms with 8 outstanding",
+                 (unsigned)latency, MAX_ALARMS / ALARMS_PAGE_SIZE, (unsigned)stopAndWait, (unsigned)pipelined);
+        TEST_MESSAGE(text);
+    }
+}
+
+int main() {
+    startTasks(); // Queues only: the tasks never run on the host
+    registerTransport(link);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_responses_echo_sequence_numbers);
+    RUN_TEST(test_crc_error_names_the_corrupted_frame);
+    RUN_TEST(test_bad_request_names_its_frame);
+    RUN_TEST(test_pipelining_at_link_latency);
+    return UNITY_END();
+}
@@ -0,0 +1,204 @@
+#include <atomic>
+#include <mbedtls/md.h>
+#include <thread>
+#include <unity.h>
+
+#include "global_vars.h"
+#include "loopback_transport.h"
+#include "schedule.h"
+#include "server.h"
+#include "tasks.h"
+
+// ============================================================================
+//   Schedule Publication
+//   A reader thread walks the published schedule while the main thread
+//   compiles thousands of versions: it must never see two versions mixed.
+//   A paged upload over the protocol stays staged until its last page,
+//   then the new table is published once. State and program type are
+//   published with it.
+// ============================================================================
+#define VERSIONS 20000
+#define CHALLENGE_LEN 16 // server.cpp
+
+static LoopbackTransport link;
+static byte token[4];
+
+// Every alarm of a version carries the same duration, derived from it
+static void compileVersion(uint16_t version) {
+    eeprom.alarmCount = 1 + version % MAX_ALARMS;
+    for (uint16_t i = 0; i < eeprom.alarmCount; i++) {
+        eeprom.alarms[i] = packAlarm(i % 24, i % 60, version % 100, 0xFF);
+    }
+    compileSchedule();
+}
+
+// One v1 request, its response payload in `payload`; -1 if none
+static int exchange(const byte *request, byte length, byte *payload) {
+    byte frame[256];
+    frame[0] = length;
+    memcpy(frame + 1, request, length);
+    link.send(frame, 1 + length);
+    execRequest();
+    return takeFrame(link, PROTOCOL_V1, payload);
+}
+
+// GET_CHALLENGE, then POST_LOGIN with its HMAC keyed by the password hash
+static void login() {
+    byte payload[64], request[1 + 32];
+
+    const byte challenge[] = {GET_CHALLENGE};
+    TEST_ASSERT_EQUAL_INT(1 + CHALLENGE_LEN, exchange(challenge, sizeof(challenge), payload));
+    TEST_ASSERT_EQUAL_HEX8(SET_CHALLENGE, payload[0]);
+
+    request[0] = POST_LOGIN;
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), eeprom.password, PASSWORD_LEN,
+                    payload + 1, CHALLENGE_LEN, request + 1);
+    TEST_ASSERT_EQUAL_INT(5, exchange(request, sizeof(request), payload));
+    TEST_ASSERT_EQUAL_HEX8(SET_SESSION, payload[0]);
+    memcpy(token, payload + 1, sizeof(token));
+}
+
+// POST_SESSION, then SET_ALARMS_PAGE `page` of a `count` alarm table
+static void sendPage(byte page, uint16_t count, const Alarm *alarms) {
+    byte request[255], payload[64];
+    byte n = min<uint16_t>(ALARMS_PAGE_SIZE, count - page * ALARMS_PAGE_SIZE);
+    byte length = 0;
+
+    request[length++] = POST_SESSION;
+    for (byte i = 0; i < sizeof(token); i++) request[length++] = token[i];
+    request[length++] = SET_ALARMS_PAGE;
+    request[length++] = page;
+    request[length++] = count & 0xFF;
+    request[length++] = count >> 8;
+    request[length++] = n;
+    memcpy(request + length, alarms + page * ALARMS_PAGE_SIZE, n * sizeof(Alarm));
+    length += n * sizeof(Alarm);
+
+    TEST_ASSERT_EQUAL_INT(-1, exchange(request, length, payload)); // Nothing to answer
+}
+
+void setUp() {
+    memset(&eeprom, 0, sizeof(eeprom));
+    eeprom.state = 1;
+    for (byte i = 0; i < PASSWORD_LEN; i++) eeprom.password[i] = 0xA0 + i;
+    compileVersion(0);
+    link.reset();
+}
+
+void tearDown() {}
+
+void test_readers_never_see_a_torn_schedule() {
+    std::atomic<bool> stop(false);
+    std::atomic<uint32_t> reads(0), torn(0);
+    uint16_t base = scheduleVersion();
+
+    std::thread reader([&] {
+        while (!stop) {
+            const Schedule *table = acquireSchedule();
+            byte duration = (uint16_t)(table->version - base) % 100;
+            for (uint16_t i = 0; i < table->alarmCount; i++) {
+                if (alarmDuration(table->alarms[i]) != duration) {
+                    torn++;
+                    break;
+                }
+            }
+            releaseSchedule(table);
+            reads++;
+        }
+    });
+
+    for (uint16_t v = 1; v <= VERSIONS; v++) compileVersion(v);
+    stop = true;
+    reader.join();
+
+    char text[80];
+    snprintf(text, sizeof(text), "%u schedules read during %u compilations", (unsigned)reads, VERSIONS);
+    TEST_MESSAGE(text);
+    TEST_ASSERT_EQUAL_UINT16((uint16_t)(base + VERSIONS), scheduleVersion());
+    TEST_ASSERT_GREATER_THAN(0, reads.load());
+    TEST_ASSERT_EQUAL_UINT32(0, torn.load());
+}
+
+// The scheduler keeps the old table until the last page, then sees the new one
+void test_paged_upload_is_published_once() {
+    const uint16_t count = 3 * ALARMS_PAGE_SIZE + 5;
+    static Alarm alarms[count];
+    for (uint16_t i = 0; i < count; i++) alarms[i] = packAlarm(i % 24, i % 60, 42, 0xFF);
+
+    login();
+    uint16_t version = scheduleVersion();
+    for (byte page = 0; page < ALARMS_PAGES(count) - 1; page++) {
+        sendPage(page, count, alarms);
+        TEST_ASSERT_EQUAL_UINT16(version, scheduleVersion());
+
+        const Schedule *table = acquireSchedule();
+        TEST_ASSERT_EQUAL_UINT16(1, table->alarmCount); // Still version 0
+        releaseSchedule(table);
+    }
+
+    sendPage(ALARMS_PAGES(count) - 1, count, alarms);
+    TEST_ASSERT_EQUAL_UINT16(version + 1, scheduleVersion());
+
+    const Schedule *table = acquireSchedule();
+    TEST_ASSERT_EQUAL_UINT16(count, table->alarmCount);
+    TEST_ASSERT_EQUAL_MEMORY(alarms, table->alarms, count * sizeof(Alarm));
+    releaseSchedule(table);
+}
+
+// Without a session, no page is staged and nothing is published
+void test_upload_needs_a_session() {
+    const uint16_t count = 5;
+    Alarm alarms[count];
+    for (uint16_t i = 0; i < count; i++) alarms[i] = packAlarm(7, i, 3, 0xFF);
+
+    memset(token, 0x55, sizeof(token));
+    uint16_t version = scheduleVersion();
+    byte request[64], payload[16];
+    byte length = 0;
+    request[length++] = POST_SESSION;
+    for (byte i = 0; i < sizeof(token); i++) request[length++] = token[i];
+    request[length++] = SET_ALARMS_PAGE;
+    request[length++] = 0;
+    request[length++] = count;
+    request[length++] = 0;
+    request[length++] = count;
+    memcpy(request + length, alarms, sizeof(alarms));
+    length += sizeof(alarms);
+
+    TEST_ASSERT_EQUAL_INT(2, exchange(request, length, payload));
+    TEST_ASSERT_EQUAL_HEX8(POST_PASSWORD_RESPONSE, payload[0]);
+    TEST_ASSERT_EQUAL_HEX8(PASSWORD_RESPONSE_INCORRECT, payload[1]);
+    TEST_ASSERT_EQUAL_UINT16(version, scheduleVersion());
+}
+
+// The alarm and UI tasks read state and program type from the published schedule
+void test_state_and_program_type_are_published() {
+    login();
+    uint16_t version = scheduleVersion();
+
+    byte request[16], payload[16];
+    byte length = 0;
+    request[length++] = POST_SESSION;
+    for (byte i = 0; i < sizeof(token); i++) request[length++] = token[i];
+    request[length++] = SET_STATE;
+    request[length++] = 0;
+    request[length++] = SET_PROGRAM_TYPE;
+    request[length++] = 1;
+    TEST_ASSERT_EQUAL_INT(-1, exchange(request, length, payload));
+
+    TEST_ASSERT_EQUAL_UINT16(version + 2, scheduleVersion());
+    TEST_ASSERT_EQUAL_UINT8(0, scheduledState());
+    TEST_ASSERT_EQUAL_UINT8(1, scheduledProgramType());
+}
+
+int main() {
+    startTasks(); // Queues only: the tasks never run on the host
+    registerTransport(link);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_readers_never_see_a_torn_schedule);
+    RUN_TEST(test_paged_upload_is_published_once);
+    RUN_TEST(test_upload_needs_a_session);
+    RUN_TEST(test_state_and_program_type_are_published);
+    return UNITY_END();
+}
@@ -0,0 +1,179 @@
+#include <chrono>
+#include <unity.h>
+
+#include "global_vars.h"
+#include "schedule.h"
+
+// ============================================================================
+//   Compiled Weekly Timeline
+//   The timeline must answer as the linear scan it replaced: for every
+//   minute of the week, the first active alarm of the table starting then.
+// ============================================================================
+static uint32_t seed;
+
+static uint32_t nextRandom() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+// Random alarms, most of them active, some sharing a minute
+static void fillAlarms(uint16_t count) {
+    seed = 0x1234567 + count;
+    eeprom.alarmCount = count;
+    for (uint16_t i = 0; i < count; i++) {
+        byte days = nextRandom() & 0xFE;
+        if (nextRandom() % 5 != 0) days |= 1;
+        eeprom.alarms[i] = packAlarm(nextRandom() % 24, nextRandom() % 60, nextRandom() % 100, days);
+    }
+    compileSchedule();
+}
+
+// The lookup of the baseline firmware, dayOfWeek 1 = Sun
+static int linearScan(byte dayOfWeek, byte hour, byte minute) {
+    for (uint16_t i = 0; i < eeprom.alarmCount; i++) {
+        Alarm alarm = eeprom.alarms[i];
+        if (bitRead(alarmDays(alarm), 0) && alarmHour(alarm) == hour && alarmMinute(alarm) == minute &&
+            bitRead(alarmDays(alarm), 8 - dayOfWeek)) {
+            return i;
+        }
+    }
+    return NO_ALARM;
+}
+
+static int linearScan(uint16_t minute) {
+    return linearScan(minute / MINUTES_PER_DAY + 1, minute % MINUTES_PER_DAY / 60, minute % 60);
+}
+
+static double elapsedNs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Walk the week minute by minute, as the alarm task does
+static void checkWeek(uint16_t count) {
+    fillAlarms(count);
+
+    auto start = std::chrono::steady_clock::now();
+    compileSchedule();
+    double compileNs = elapsedNs(start);
+
+    int expected[MINUTES_PER_WEEK];
+    start = std::chrono::steady_clock::now();
+    for (uint16_t m = 0; m < MINUTES_PER_WEEK; m++) expected[m] = linearScan(m);
+    double scanNs = elapsedNs(start);
+
+    const Schedule *table = acquireSchedule();
+    int found[MINUTES_PER_WEEK];
+    start = std::chrono::steady_clock::now();
+    for (uint16_t m = 0; m < MINUTES_PER_WEEK; m++) found[m] = scheduledAlarm(*table, m);
+    double lookupNs = elapsedNs(start);
+    releaseSchedule(table);
+
+    for (uint16_t m = 0; m < MINUTES_PER_WEEK; m++) {
+        TEST_ASSERT_EQUAL_INT_MESSAGE(expected[m], found[m], "alarm of the minute");
+    }
+
+    char text[160];
+    snprintf(text, sizeof(text), "%u alarms: lookup %.1f ns, linear scan %.1f ns per minute, compile %.0f us",
+             count, lookupNs / MINUTES_PER_WEEK, scanNs / MINUTES_PER_WEEK, compileNs / 1000);
+    TEST_MESSAGE(text);
+}
+
+void setUp() {
+    memset(&eeprom, 0, sizeof(eeprom));
+}
+
+void tearDown() {}
+
+void test_week_matches_linear_scan_40_alarms() {
+    checkWeek(40);
+}
+
+void test_week_matches_linear_scan_500_alarms() {
+    checkWeek(500);
+}
+
+void test_week_matches_linear_scan_max_alarms() {
+    checkWeek(MAX_ALARMS);
+}
+
+// Runs first: no lookup has placed the cursor yet, whatever the version
+void test_unplaced_cursor_is_not_trusted() {
+    eeprom.alarmCount = 1;
+    eeprom.alarms[0] = packAlarm(6, 0, 5, 0xFF);
+    while (scheduleVersion() != 0xFFFF) compileSchedule();
+
+    const Schedule *table = acquireSchedule();
+    uint16_t next = nextEventMinute(*table, 0);
+    int idx = scheduledAlarm(*table, minuteOfWeek(1, 6, 0));
+    releaseSchedule(table); // Before asserting: a held buffer would block the next compile
+    TEST_ASSERT_EQUAL_UINT16(minuteOfWeek(1, 6, 0), next);
+    TEST_ASSERT_EQUAL_INT(0, idx);
+}
+
+// A clock change moves the lookup anywhere in the week
+void test_random_minutes_match_linear_scan() {
+    fillAlarms(500);
+
+    const Schedule *table = acquireSchedule();
+    for (int i = 0; i < 20000; i++) {
+        uint16_t m = nextRandom() % MINUTES_PER_WEEK;
+        TEST_ASSERT_EQUAL_INT(linearScan(m), scheduledAlarm(*table, m));
+    }
+    releaseSchedule(table);
+}
+
+void test_shared_minute_keeps_first_alarm() {
+    eeprom.alarmCount = 3;
+    eeprom.alarms[0] = packAlarm(8, 0, 5, 0x01);  // Active, no day
+    eeprom.alarms[1] = packAlarm(8, 0, 5, 0xFF);  // Every day
+    eeprom.alarms[2] = packAlarm(8, 0, 9, 0x83);  // Sunday and Saturday
+    compileSchedule();
+
+    const Schedule *table = acquireSchedule();
+    TEST_ASSERT_EQUAL_INT(1, scheduledAlarm(*table, minuteOfWeek(1, 8, 0)));
+    TEST_ASSERT_EQUAL_INT(1, scheduledAlarm(*table, minuteOfWeek(7, 8, 0)));
+    TEST_ASSERT_EQUAL_INT(NO_ALARM, scheduledAlarm(*table, minuteOfWeek(7, 8, 1)));
+    TEST_ASSERT_EQUAL_UINT16(7, table->eventCount);
+    releaseSchedule(table);
+}
+
+void test_next_event_matches_linear_scan() {
+    fillAlarms(40);
+
+    const Schedule *table = acquireSchedule();
+    for (uint16_t m = 0; m < MINUTES_PER_WEEK; m++) {
+        uint16_t next = m;
+        for (uint16_t i = 0; i < MINUTES_PER_WEEK; i++, next = (next + 1) % MINUTES_PER_WEEK) {
+            if (linearScan(next) != NO_ALARM) break;
+        }
+        TEST_ASSERT_EQUAL_UINT16(next, nextEventMinute(*table, m));
+    }
+    releaseSchedule(table);
+}
+
+void test_inactive_alarms_never_fire() {
+    fillAlarms(100);
+    for (uint16_t i = 0; i < eeprom.alarmCount; i++) eeprom.alarms[i] &= ~(1UL << ALARM_DAYS_SHIFT);
+    compileSchedule();
+
+    const Schedule *table = acquireSchedule();
+    TEST_ASSERT_EQUAL_UINT16(0, table->eventCount);
+    TEST_ASSERT_EQUAL_UINT16(MINUTES_PER_WEEK, nextEventMinute(*table, 0));
+    for (uint16_t m = 0; m < MINUTES_PER_WEEK; m++) TEST_ASSERT_EQUAL_INT(NO_ALARM, scheduledAlarm(*table, m));
+    releaseSchedule(table);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_unplaced_cursor_is_not_trusted);
+    RUN_TEST(test_week_matches_linear_scan_40_alarms);
+    RUN_TEST(test_week_matches_linear_scan_500_alarms);
+    RUN_TEST(test_week_matches_linear_scan_max_alarms);
+    RUN_TEST(test_random_minutes_match_linear_scan);
+    RUN_TEST(test_shared_minute_keeps_first_alarm);
+    RUN_TEST(test_next_event_matches_linear_scan);
+    RUN_TEST(test_inactive_alarms_never_fire);
+    return UNITY_END();
+}
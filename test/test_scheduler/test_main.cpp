@@ -0,0 +1,170 @@
+#include <unity.h>
+
+#include "global_vars.h"
+#include "schedule.h"
+#include "tasks.h"
+#include "utils.h"
+
+// ============================================================================
+//   Event-Driven Scheduler
+//   Virtual clock harness: the alarm task is replayed by calling
+//   runScheduler() and moving the tick counter by the delay it returns,
+//   over a simulated week. The baseline polled at 1 Hz: 604,800 wakeups.
+// ============================================================================
+#define WEEK_MS (7 * 86400000UL)
+#define POLLING_WAKEUPS 604800UL
+
+struct WeekRun {
+    uint32_t wakeups;
+    uint32_t fired;             // EVENT_ALARM_FIRED
+    uint32_t lateOnsets;        // Fired away from the start of their minute
+};
+
+static uint32_t seed;
+
+static uint32_t nextRandom() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static void fillAlarms(uint16_t count) {
+    seed = 0xC0FFEE + count;
+    eeprom.alarmCount = count;
+    for (uint16_t i = 0; i < count; i++) {
+        eeprom.alarms[i] = packAlarm(nextRandom() % 24, nextRandom() % 60, 1 + nextRandom() % 30,
+                                     (nextRandom() & 0xFE) | 1);
+    }
+    compileSchedule();
+}
+
+static void drainEvents(WeekRun &run) {
+    Event event;
+    while (takeEvent(event)) {
+        if (event.type != EVENT_ALARM_FIRED) continue;
+        run.fired++;
+        ClockTime now = getClock();
+        if (now.second != 0 || ticks != now.tick) run.lateOnsets++;
+    }
+}
+
+// Sunday 00:00:00, then the alarm task as it runs on the device. With
+// `spurious`, requestWakeup() calls also wake it at random times.
+static WeekRun runWeek(bool spurious = false) {
+    WeekRun run = {};
+    Wire.rtc.set(2026, 10, 18, 1, 0, 0, 0);
+    resyncClock();
+
+    uint32_t start = ticks;
+    while (ticks - start < WEEK_MS) {
+        uint32_t sleep = runScheduler();
+        run.wakeups++;
+        drainEvents(run);
+
+        if (spurious && sleep > 1) sleep = 1 + nextRandom() % sleep;
+        ticks = ticks + sleep;
+    }
+    return run;
+}
+
+// Wakeups the schedule needs: one per alarm start and one per countdown
+// step, plus one per MAX_SLEEP when nothing is due
+static uint32_t neededWakeups() {
+    const Schedule *table = acquireSchedule();
+    uint32_t wakeups = WEEK_MS / MAX_SLEEP + 1;
+    for (uint16_t i = 0; i < table->eventCount; i++) {
+        wakeups += 2 + alarmDuration(table->alarms[table->events[i]]);
+    }
+    releaseSchedule(table);
+    return wakeups;
+}
+
+static uint16_t weeklyEvents() {
+    const Schedule *table = acquireSchedule();
+    uint16_t events = table->eventCount;
+    releaseSchedule(table);
+    return events;
+}
+
+void setUp() {
+    memset(&eeprom, 0, sizeof(eeprom));
+    eeprom.state = 1;
+    compileSchedule();
+}
+
+void tearDown() {}
+
+void test_idle_week_wakes_once_per_max_sleep() {
+    WeekRun run = runWeek();
+
+    TEST_ASSERT_EQUAL_UINT32(0, run.fired);
+    TEST_ASSERT_EQUAL_UINT32(WEEK_MS / MAX_SLEEP, run.wakeups);
+}
+
+void test_home_screen_does_not_shorten_sleep() {
+    currentMenu = HOME;
+    runWeek();
+    TEST_ASSERT_EQUAL_UINT32(MAX_SLEEP, runScheduler());
+}
+
+void test_week_of_40_alarms() {
+    fillAlarms(40);
+    WeekRun run = runWeek();
+
+    TEST_ASSERT_EQUAL_UINT32(weeklyEvents(), run.fired);
+    TEST_ASSERT_EQUAL_UINT32(0, run.lateOnsets);
+    TEST_ASSERT_LESS_OR_EQUAL(neededWakeups(), run.wakeups);
+
+    char text[120];
+    snprintf(text, sizeof(text), "40 alarms, %u starts: %u wakeups in a week, %u with 1 Hz polling",
+             run.fired, run.wakeups, (unsigned)POLLING_WAKEUPS);
+    TEST_MESSAGE(text);
+}
+
+void test_week_of_max_alarms() {
+    fillAlarms(MAX_ALARMS);
+    WeekRun run = runWeek();
+
+    TEST_ASSERT_EQUAL_UINT32(weeklyEvents(), run.fired);
+    TEST_ASSERT_EQUAL_UINT32(0, run.lateOnsets);
+    TEST_ASSERT_LESS_OR_EQUAL(neededWakeups(), run.wakeups);
+    TEST_ASSERT_LESS_THAN(POLLING_WAKEUPS, run.wakeups);
+
+    char text[120];
+    snprintf(text, sizeof(text), "%u alarms, %u starts: %u wakeups in a week, %u with 1 Hz polling",
+             MAX_ALARMS, run.fired, run.wakeups, (unsigned)POLLING_WAKEUPS);
+    TEST_MESSAGE(text);
+}
+
+// Waking up early must neither fire an alarm twice nor miss one
+void test_early_wakeups_are_harmless() {
+    fillAlarms(40);
+    WeekRun run = runWeek(true);
+
+    TEST_ASSERT_EQUAL_UINT32(weeklyEvents(), run.fired);
+    TEST_ASSERT_EQUAL_UINT32(0, run.lateOnsets);
+}
+
+void test_stopped_program_sleeps() {
+    fillAlarms(40);
+    eeprom.state = 0;
+    compileSchedule();
+    WeekRun run = runWeek();
+
+    TEST_ASSERT_EQUAL_UINT32(0, run.fired);
+    TEST_ASSERT_EQUAL_UINT32(WEEK_MS / MAX_SLEEP, run.wakeups);
+}
+
+int main() {
+    startTasks(); // Queues only: the tasks never run on the host
+
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_week_wakes_once_per_max_sleep);
+    RUN_TEST(test_home_screen_does_not_shorten_sleep);
+    RUN_TEST(test_week_of_40_alarms);
+    RUN_TEST(test_week_of_max_alarms);
+    RUN_TEST(test_early_wakeups_are_harmless);
+    RUN_TEST(test_stopped_program_sleeps);
+    return UNITY_END();
+}
@@ -0,0 +1,106 @@
+#include <unity.h>
+
+#include "display.h"
+#include "global_vars.h"
+#include "utils.h"
+
+// ============================================================================
+//   7-Segment Multiplexing ISR
+//   GPIO registers are mocked and every access is counted: the ISR budget
+//   is two W1TS/W1TC writes and no read per call, whatever is shown.
+// ============================================================================
+#define DIGITS (uint32_t)((1UL << DIGIT1) | (1UL << DIGIT2))
+
+extern boolean firstDigit; // main.cpp
+
+// Check the pins after an ISR call: one digit enabled (active low),
+// showing the tens or the ones of `value`
+static void expectDigit(byte value) {
+    uint32_t shown = firstDigit ? bcd[value / 10] : bcd[value % 10];
+    uint32_t enabled = firstDigit ? 1UL << DIGIT1 : 1UL << DIGIT2;
+
+    TEST_ASSERT_EQUAL_HEX32(DIGITS & ~enabled, mockGpio.out & DIGITS);
+    TEST_ASSERT_EQUAL_HEX32(shown, mockGpio.out & ABCD);
+}
+
+void setUp() {
+    mockGpio.out = 0;
+    setDuration(0);
+}
+
+void tearDown() {}
+
+void test_isr_costs_two_writes_and_no_read() {
+    uint32_t writes = mockGpio.regWrites;
+    uint32_t reads = mockGpio.regReads + mockGpio.pinReads;
+
+    for (int i = 0; i < 1000; i++) {
+        if (i % 100 == 0) setDuration(i / 10);
+        onSevenSegmentDisplayToggle();
+    }
+    TEST_ASSERT_EQUAL_UINT32(2 * 1000, mockGpio.regWrites - writes);
+    TEST_ASSERT_EQUAL_UINT32(reads, mockGpio.regReads + mockGpio.pinReads);
+
+    char text[100];
+    snprintf(text, sizeof(text), "%u register writes, %u reads per ISR call",
+             (unsigned)((mockGpio.regWrites - writes) / 1000), (unsigned)(mockGpio.regReads + mockGpio.pinReads - reads));
+    TEST_MESSAGE(text);
+}
+
+void test_digits_alternate() {
+    setDuration(42);
+
+    onSevenSegmentDisplayToggle();
+    bool first = firstDigit;
+    expectDigit(42);
+    onSevenSegmentDisplayToggle();
+    TEST_ASSERT_NOT_EQUAL(first, firstDigit);
+    expectDigit(42);
+}
+
+void test_every_duration_is_shown() {
+    for (byte value = 0; value < 100; value++) {
+        setDuration(value);
+        onSevenSegmentDisplayToggle();
+        expectDigit(value);
+        onSevenSegmentDisplayToggle();
+        expectDigit(value);
+    }
+}
+
+// The masks are built when the duration changes, not in the ISR
+void test_set_duration_touches_no_register() {
+    uint32_t writes = mockGpio.regWrites;
+    uint32_t out = mockGpio.out;
+
+    setDuration(17);
+    TEST_ASSERT_EQUAL_UINT32(writes, mockGpio.regWrites);
+    TEST_ASSERT_EQUAL_HEX32(out, mockGpio.out);
+    TEST_ASSERT_EQUAL_UINT8(17, duration);
+}
+
+// Other outputs, driven by the tasks, are never written back by the ISR
+void test_other_outputs_are_preserved() {
+    const uint32_t others = ~(DIGITS | ABCD);
+
+    mockGpio.out = (1UL << RELAY) | (1UL << LED);
+    for (byte value = 0; value < 100; value += 7) {
+        setDuration(value);
+        onSevenSegmentDisplayToggle();
+        TEST_ASSERT_EQUAL_HEX32((1UL << RELAY) | (1UL << LED), mockGpio.out & others);
+    }
+
+    mockGpio.out = 0;
+    onSevenSegmentDisplayToggle();
+    TEST_ASSERT_EQUAL_HEX32(0, mockGpio.out & others);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_isr_costs_two_writes_and_no_read);
+    RUN_TEST(test_digits_alternate);
+    RUN_TEST(test_every_duration_is_shown);
+    RUN_TEST(test_set_duration_touches_no_register);
+    RUN_TEST(test_other_outputs_are_preserved);
+    return UNITY_END();
+}
@@ -0,0 +1,118 @@
+#include <unity.h>
+
+#include "global_vars.h"
+#include "schedule.h"
+#include "tasks.h"
+#include "utils.h"
+
+// ============================================================================
+//   Lossless Tick Accounting
+//   Time only moves through the 7-segment ISR here, one tick per call, as
+//   on the device. A stalled alarm task must catch up the countdown steps
+//   it slept through and still end the countdown on time.
+// ============================================================================
+static void advance(uint32_t ms) {
+    while (ms--) onSevenSegmentDisplayToggle();
+}
+
+static bool relayOn() {
+    return !bitRead(mockGpio.out, RELAY); // Active low
+}
+
+static uint32_t sleepMs; // Delay returned by the last run
+
+// Sleep as long as the scheduler asked, then run it, as the alarm task does
+static void wake() {
+    advance(sleepMs);
+    sleepMs = runScheduler();
+}
+
+static bool takeEventType(byte type) {
+    Event event;
+    bool found = false;
+    while (takeEvent(event)) found |= event.type == type;
+    return found;
+}
+
+void setUp() {
+    memset(&eeprom, 0, sizeof(eeprom));
+    eeprom.state = 1;
+    eeprom.programType = 0;
+    eeprom.alarmCount = 1;
+    eeprom.alarms[0] = packAlarm(8, 0, 5, 0xFF); // 08:00 every day, 5 s
+    compileSchedule();
+
+    Wire.rtc.set(2026, 10, 18, 1, 7, 59, 59);
+    resyncClock();
+    sleepMs = runScheduler();
+    takeEventType(EVENT_ALARM_ENDED);
+}
+
+void tearDown() {}
+
+void test_isr_counts_every_tick() {
+    uint32_t start = ticks;
+    advance(12345);
+    TEST_ASSERT_EQUAL_UINT32(12345, ticks - start);
+}
+
+void test_countdown_ends_on_time_after_stall() {
+    wake(); // 08:00:00, the first step is taken at once
+    TEST_ASSERT_TRUE(takeEventType(EVENT_ALARM_FIRED));
+    uint32_t onset = ticks;
+    TEST_ASSERT_TRUE(relayOn());
+    TEST_ASSERT_EQUAL_UINT8(4, duration);
+
+    // The task is held for 2.3 s: two steps are due when it runs again
+    uint32_t missed = missedTicks;
+    advance(2300);
+    sleepMs = runScheduler();
+    TEST_ASSERT_EQUAL_UINT8(2, duration);
+    TEST_ASSERT_EQUAL_UINT32(missed + 1, missedTicks); // 1.3 s late on the step due at +1 s
+    TEST_ASSERT_EQUAL_UINT32(700, sleepMs);             // Back on the original cadence
+
+    while (!takeEventType(EVENT_ALARM_ENDED)) wake();
+    TEST_ASSERT_EQUAL_UINT32(onset + 5000, ticks);
+    TEST_ASSERT_FALSE(relayOn());
+    TEST_ASSERT_EQUAL_UINT8(0, duration);
+}
+
+void test_countdown_without_stall_steps_every_second() {
+    wake();
+    TEST_ASSERT_TRUE(takeEventType(EVENT_ALARM_FIRED));
+    uint32_t onset = ticks;
+    uint32_t missed = missedTicks;
+
+    for (byte left = 4; left > 0; left--) {
+        TEST_ASSERT_EQUAL_UINT8(left, duration);
+        TEST_ASSERT_EQUAL_UINT32(onset + (4 - left) * 1000, ticks);
+        TEST_ASSERT_EQUAL_UINT32(1000, sleepMs);
+        wake();
+    }
+    TEST_ASSERT_EQUAL_UINT8(0, duration);
+    wake();
+    TEST_ASSERT_TRUE(takeEventType(EVENT_ALARM_ENDED));
+    TEST_ASSERT_EQUAL_UINT32(onset + 5000, ticks);
+    TEST_ASSERT_EQUAL_UINT32(missed, missedTicks);
+}
+
+// A stall over the start of the minute delays the onset, which is reported
+void test_stall_over_onset_is_reported() {
+    advance(sleepMs + 2300); // Due at 08:00:00, runs at 08:00:02.3
+    sleepMs = runScheduler();
+
+    TEST_ASSERT_TRUE(takeEventType(EVENT_ALARM_FIRED));
+    TEST_ASSERT_GREATER_OR_EQUAL(2300, getOnsetLatency());
+    TEST_ASSERT_TRUE(relayOn());
+}
+
+int main() {
+    startTasks(); // Queues only: the tasks never run on the host
+
+    UNITY_BEGIN();
+    RUN_TEST(test_isr_counts_every_tick);
+    RUN_TEST(test_countdown_ends_on_time_after_stall);
+    RUN_TEST(test_countdown_without_stall_steps_every_second);
+    RUN_TEST(test_stall_over_onset_is_reported);
+    return UNITY_END();
+}
@@ -0,0 +1,151 @@
+#include <new>
+#include <unity.h>
+
+#include "global_vars.h"
+#include "loopback_transport.h"
+#include "server.h"
+#include "tasks.h"
+
+// ============================================================================
+//   Request Deadline
+//   A request must be received within REQUEST_TIMEOUT of its size byte,
+//   checked against one deadline: no task or timer is created, nothing is
+//   allocated, however the frames are split.
+// ============================================================================
+#define REQUEST_TIMEOUT 2000 // server.cpp
+
+static uint32_t allocations;
+
+void *operator new(size_t size) {
+    allocations++;
+    void *p = malloc(size);
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t size) noexcept { free(p); }
+
+static LoopbackTransport link;
+static uint32_t seed = 0x5EED;
+
+static uint32_t nextRandom() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+// Check the next response frame (v1)
+static void expectResponse(const byte *expected, byte length) {
+    byte payload[256];
+    TEST_ASSERT_EQUAL_INT(length, takeFrame(link, PROTOCOL_V1, payload));
+    TEST_ASSERT_EQUAL_MEMORY(expected, payload, length);
+}
+
+void setUp() {
+    link.reset();
+    memset(&eeprom, 0, sizeof(eeprom));
+    eeprom.state = 1;
+    eeprom.programType = 1;
+    eeprom.alarmCount = 3;
+    for (byte i = 0; i < 3; i++) eeprom.alarms[i] = packAlarm(8 + i, 0, 1, 0xFF);
+    compileSchedule();
+    execRequest();
+}
+
+void tearDown() {}
+
+void test_fragmented_requests_are_all_answered() {
+    static byte stream[10000 * 3];
+    static byte expected[10000];
+    size_t length = 0;
+
+    // GET_STATE, GET_PROGRAM_TYPE and GET_ALARMS_PAGE, in random order
+    for (int i = 0; i < 10000; i++) {
+        expected[i] = nextRandom() % 3;
+        if (expected[i] == 0) { stream[length++] = 1; stream[length++] = GET_STATE; }
+        if (expected[i] == 1) { stream[length++] = 1; stream[length++] = GET_PROGRAM_TYPE; }
+        if (expected[i] == 2) { stream[length++] = 2; stream[length++] = GET_ALARMS_PAGE; stream[length++] = 0; }
+    }
+
+    const byte state[] = {SET_STATE, 1};
+    const byte type[] = {SET_PROGRAM_TYPE, 1};
+    byte page[5 + 3 * 4] = {SET_ALARMS_PAGE, 0, 3, 0, 3};
+    for (byte i = 0; i < 3; i++) memcpy(page + 5 + 4 * i, &eeprom.alarms[i], 4);
+
+    uint32_t before = allocations;
+    uint32_t fragments = 0;
+    int answered = 0;
+    for (size_t sent = 0; sent < length; fragments++) {
+        size_t n = min<size_t>(1 + nextRandom() % 9, length - sent);
+        link.send(stream + sent, n);
+        sent += n;
+        execRequest();
+        ticks = ticks + 1;
+
+        // Every complete request is answered before the next fragment
+        for (; link.received() > 0; answered++) {
+            if (expected[answered] == 0) expectResponse(state, sizeof(state));
+            if (expected[answered] == 1) expectResponse(type, sizeof(type));
+            if (expected[answered] == 2) expectResponse(page, sizeof(page));
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(before, allocations);
+    TEST_ASSERT_EQUAL_INT(10000, answered);
+    TEST_ASSERT_EQUAL_UINT32(0, link.received());
+
+    char text[100];
+    snprintf(text, sizeof(text), "10000 requests in %u fragments, no allocation", (unsigned)fragments);
+    TEST_MESSAGE(text);
+}
+
+void test_incomplete_request_times_out() {
+    const byte partial[] = {3, GET_STATE};
+    uint32_t before = allocations;
+
+    link.send(partial, sizeof(partial));
+    execRequest();
+    ticks = ticks + REQUEST_TIMEOUT - 1;
+    execRequest();
+    TEST_ASSERT_EQUAL_UINT32(0, link.received());
+
+    ticks = ticks + 1;
+    execRequest();
+    const byte timeout[] = {TIMEOUT};
+    expectResponse(timeout, sizeof(timeout));
+    TEST_ASSERT_EQUAL_UINT32(before, allocations);
+
+    // The parser starts over with the next request
+    const byte request[] = {1, GET_STATE};
+    const byte state[] = {SET_STATE, 1};
+    link.send(request, sizeof(request));
+    execRequest();
+    expectResponse(state, sizeof(state));
+}
+
+// The deadline covers the whole request, not the silence between fragments
+void test_slow_fragments_time_out() {
+    const byte request[] = {2, GET_ALARMS_PAGE, 0};
+
+    link.send(request, 2);
+    execRequest();
+    ticks = ticks + REQUEST_TIMEOUT;
+    link.send(request + 2, 1);
+    execRequest();
+
+    const byte timeout[] = {TIMEOUT};
+    expectResponse(timeout, sizeof(timeout));
+    TEST_ASSERT_EQUAL_UINT32(0, link.received());
+}
+
+int main() {
+    startTasks(); // Queues only: the tasks never run on the host
+    registerTransport(link);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_fragmented_requests_are_all_answered);
+    RUN_TEST(test_incomplete_request_times_out);
+    RUN_TEST(test_slow_fragments_time_out);
+    return UNITY_END();
+}
@@ -0,0 +1,187 @@
+#include <unity.h>
+
+#include "fd_transport.h"
+#include "global_vars.h"
+#include "loopback_transport.h"
+#include "server.h"
+#include "tasks.h"
+
+// ============================================================================
+//   Transport-Agnostic Protocol Engine
+//   The unchanged engine serves real Linux file descriptors: a socket pair
+//   and a raw pty whose slave is opened like a serial port. A loopback link
+//   registered after them shows which link is served. The UART-style
+//   StreamTransport is checked for its link state rules.
+// ============================================================================
+static FdTransport socketLink;
+static FdTransport ptyLink;
+static LoopbackTransport standby; // Served only once the fd links are released
+
+// Run the engine until `client` can read a whole v1 frame, then read it
+static int exchange(int client, const byte *request, size_t length, byte *payload) {
+    TEST_ASSERT_EQUAL_INT((int)length, (int)write(client, request, length));
+
+    byte frame[256];
+    size_t received = 0;
+    for (int spins = 0; spins < 10000; spins++) {
+        execRequest();
+        struct pollfd p = {client, POLLIN, 0};
+        if (poll(&p, 1, 1) > 0 && (p.revents & POLLIN)) {
+            ssize_t n = read(client, frame + received, sizeof(frame) - received);
+            if (n > 0) received += n;
+        }
+        if (received > 0 && received >= 1 + (size_t)frame[0]) {
+            memcpy(payload, frame + 1, frame[0]);
+            return frame[0];
+        }
+    }
+    return -1;
+}
+
+// 1000 GET_STATE requests over the link, each answered
+static void runRequests(int client) {
+    const byte request[] = {1, GET_STATE};
+    byte payload[256];
+
+    for (int i = 0; i < 1000; i++) {
+        TEST_ASSERT_EQUAL_INT(2, exchange(client, request, sizeof(request), payload));
+        TEST_ASSERT_EQUAL_HEX8(SET_STATE, payload[0]);
+        TEST_ASSERT_EQUAL_UINT8(eeprom.state, payload[1]);
+    }
+}
+
+// A GET_STATE on the standby link waits while another link is served
+static void expectStandbyWaits() {
+    const byte request[] = {1, GET_STATE};
+    standby.attached = true;
+    standby.send(request, sizeof(request));
+    for (int spins = 0; spins < 100; spins++) execRequest();
+    TEST_ASSERT_EQUAL_UINT32(0, standby.received());
+}
+
+// Serve until the engine lets the fd link go and answers the standby link
+static void waitReleased() {
+    for (int spins = 0; spins < 100 && standby.received() == 0; spins++) execRequest();
+
+    byte payload[8];
+    TEST_ASSERT_EQUAL_INT(2, takeFrame(standby, PROTOCOL_V1, payload));
+    TEST_ASSERT_EQUAL_HEX8(SET_STATE, payload[0]);
+
+    standby.attached = false;
+    execRequest(); // Released in turn
+}
+
+void setUp() {
+    memset(&eeprom, 0, sizeof(eeprom));
+    eeprom.state = 1;
+    compileSchedule();
+    standby.attached = false;
+    standby.reset();
+}
+
+void tearDown() {}
+
+void test_socket_pair() {
+    int device, client;
+    TEST_ASSERT_TRUE(openSocketPair(device, client));
+    socketLink.attach(device);
+
+    runRequests(client);
+    expectStandbyWaits();
+
+    close(client); // The client hangs up
+    waitReleased();
+    socketLink.attach(-1);
+    close(device);
+}
+
+void test_pty() {
+    int device;
+    char path[64];
+    TEST_ASSERT_TRUE(openPty(device, path, sizeof(path)));
+    ptyLink.attach(device);
+
+    int client = open(path, O_RDWR | O_NOCTTY);
+    TEST_ASSERT_TRUE(client >= 0);
+    struct termios mode;
+    tcgetattr(client, &mode);
+    cfmakeraw(&mode);
+    tcsetattr(client, TCSANOW, &mode);
+
+    runRequests(client);
+    expectStandbyWaits();
+
+    close(client);
+    waitReleased();
+    ptyLink.attach(-1);
+    close(device);
+}
+
+// DISCONNECTED closes the served link, for links without a connection state
+void test_disconnected_closes_the_link() {
+    const byte request[] = {1, DISCONNECTED};
+    standby.attached = true;
+    uint32_t closes = standby.closes;
+
+    standby.send(request, sizeof(request));
+    execRequest();
+    TEST_ASSERT_EQUAL_UINT32(closes + 1, standby.closes);
+
+    standby.attached = false;
+    execRequest();
+}
+
+// ============================================================================
+//   Stream Transport
+// ============================================================================
+class FakeStream : public Stream {
+  public:
+    ByteQueue input;
+
+    int available() override { return input.size(); }
+    int read() override { return input.pop(); }
+    size_t write(uint8_t c) override { return 1; }
+};
+
+static FakeStream uart;
+
+void test_stream_is_taken_by_first_byte() {
+    StreamTransport link(uart);
+    TEST_ASSERT_FALSE(link.connected());
+
+    uart.input.push(1);
+    TEST_ASSERT_TRUE(link.connected());
+    uart.input.clear();
+    TEST_ASSERT_TRUE(link.connected());
+
+    link.close(); // DISCONNECTED
+    TEST_ASSERT_FALSE(link.connected());
+}
+
+void test_stream_released_after_silence() {
+    StreamTransport link(uart);
+
+    uart.input.push(1);
+    TEST_ASSERT_TRUE(link.connected());
+    uart.input.clear();
+
+    ticks = ticks + STREAM_IDLE_TIMEOUT - 1;
+    TEST_ASSERT_TRUE(link.connected());
+    ticks = ticks + 1;
+    TEST_ASSERT_FALSE(link.connected());
+}
+
+int main() {
+    startTasks(); // Queues only: the tasks never run on the host
+    registerTransport(socketLink);
+    registerTransport(ptyLink);
+    registerTransport(standby);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_stream_is_taken_by_first_byte);
+    RUN_TEST(test_stream_released_after_silence);
+    RUN_TEST(test_socket_pair);
+    RUN_TEST(test_pty);
+    RUN_TEST(test_disconnected_closes_the_link);
+    return UNITY_END();
+}
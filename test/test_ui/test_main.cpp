@@ -0,0 +1,154 @@
+#include <unity.h>
+
+#include "buttons.h"
+#include "display.h"
+#include "global_vars.h"
+#include "tasks.h"
+#include "utils.h"
+
+// ============================================================================
+//   Non-Blocking UI
+//   The UI task is replayed pass by pass: it sleeps until its earliest
+//   deadline, then runs. Nothing it calls may take time, so messages,
+//   chirps and the menu lock happen exactly at their deadlines.
+// ============================================================================
+struct Trace {
+    uint32_t passes;            // UI task passes
+    uint32_t tones[8];          // Tick of each tone
+    byte toneCount;
+};
+
+extern QueueHandle_t uiQueue; // tasks.cpp
+
+// One pass of the UI task, after its wait
+static void uiPass() {
+    UiMessage message;
+
+    while (xQueueReceive(uiQueue, &message, 0) == pdTRUE) {
+        showMessage(message.top, message.bottom[0] != '\0' ? message.bottom : NULL);
+        if (message.toneLength != 0) tone(BUZZER, BUZZER_FREQ, message.toneLength);
+        if (message.chirps != 0) chirp(message.chirps);
+    }
+    readBtns();
+    handleMenu();
+    if (currentMenu == HOME && !isMessageShown()) {
+        serviceClock();
+        refreshHome();
+    }
+    serviceMessage();
+    serviceBuzzer();
+}
+
+static uint32_t uiWait() {
+    return min(min(buttonsTimeLeft(), messageTimeLeft()),
+               min(min(chirpTimeLeft(), lockTimeLeft()), homeTimeLeft()));
+}
+
+// Run the UI task until `until` returns true, recording the tones
+static void runUi(Trace &trace, bool (*until)()) {
+    uint32_t tones = mockTone.count;
+
+    while (!until()) {
+        uint32_t wait = uiWait();
+        TEST_ASSERT_NOT_EQUAL(NO_DEADLINE, wait);
+
+        ticks = ticks + wait;
+        uint32_t before = ticks;
+        uiPass();
+        TEST_ASSERT_EQUAL_UINT32(before, ticks); // A pass takes no time
+
+        trace.passes++;
+        if (mockTone.count != tones && trace.toneCount < 8) trace.tones[trace.toneCount++] = mockTone.tick;
+        tones = mockTone.count;
+    }
+}
+
+static bool messageGone() { return !isMessageShown(); }
+static bool chirpsDone() { return chirpTimeLeft() == NO_DEADLINE; }
+static bool onHome() { return currentMenu == HOME; }
+
+void setUp() {
+    memset(&eeprom, 0, sizeof(eeprom));
+    eeprom.alarmCount = 2;
+    eeprom.alarms[0] = packAlarm(8, 0, 5, 0xFF);
+    eeprom.alarms[1] = packAlarm(9, 30, 5, 0xFF);
+    compileSchedule();
+
+    Wire.rtc.set(2026, 10, 18, 1, 12, 0, 0);
+    resyncClock();
+    serviceClock();
+
+    // Leave any previous screen, start from an idle home screen
+    Trace trace = {};
+    currentMenu = HOME;
+    runUi(trace, messageGone);
+    runUi(trace, chirpsDone);
+}
+
+void tearDown() {}
+
+void test_message_is_shown_without_waiting() {
+    uint32_t start = ticks;
+    postMessage("   CONNECTED    ", NULL, 2);
+    uiPass();
+
+    TEST_ASSERT_EQUAL_UINT32(start, ticks);
+    TEST_ASSERT_TRUE(isMessageShown());
+    TEST_ASSERT_EQUAL_UINT32(MSG_DELAY, messageTimeLeft());
+
+    Trace trace = {};
+    runUi(trace, messageGone);
+    TEST_ASSERT_EQUAL_UINT32(start + MSG_DELAY, ticks);
+    TEST_ASSERT_EQUAL_UINT8(1, trace.toneCount); // The second chirp, the first played at once
+    TEST_ASSERT_EQUAL_UINT32(start + CHIRP_PERIOD, trace.tones[0]);
+}
+
+void test_chirps_keep_their_period() {
+    uint32_t start = ticks;
+    chirp(3);
+
+    Trace trace = {};
+    runUi(trace, chirpsDone);
+    TEST_ASSERT_EQUAL_UINT8(2, trace.toneCount);
+    TEST_ASSERT_EQUAL_UINT32(start + CHIRP_PERIOD, trace.tones[0]);
+    TEST_ASSERT_EQUAL_UINT32(start + 2 * CHIRP_PERIOD, trace.tones[1]);
+}
+
+void test_alarms_menu_locks_after_idle_time() {
+    mockPinEdge(LOCK_BTN, LOW);
+    uiPass();
+    TEST_ASSERT_EQUAL(ALARMS, currentMenu);
+    uint32_t pressed = ticks;
+    ticks = ticks + 100;
+    mockPinEdge(LOCK_BTN, HIGH);
+
+    Trace trace = {};
+    runUi(trace, onHome);
+    TEST_ASSERT_EQUAL_UINT32(pressed + LOCK_TIME * 1000UL + 1, ticks);
+    TEST_ASSERT_LESS_OR_EQUAL(4, trace.passes); // Release, settle, lock
+}
+
+// The home clock is redrawn once per second, at the start of the second
+void test_home_clock_wakes_once_per_second() {
+    uint32_t first = 0;
+
+    for (int i = 0; i < 10; i++) {
+        ticks = ticks + uiWait();
+        uiPass();
+        TEST_ASSERT_EQUAL_UINT32(getClock().tick, ticks);
+        if (i == 0) first = ticks;
+    }
+    TEST_ASSERT_EQUAL_UINT32(first + 9000, ticks);
+}
+
+int main() {
+    initButtons();
+    startTasks(); // Queues only: the tasks never run on the host
+
+    UNITY_BEGIN();
+    RUN_TEST(test_message_is_shown_without_waiting);
+    RUN_TEST(test_chirps_keep_their_period);
+    RUN_TEST(test_alarms_menu_locks_after_idle_time);
+    RUN_TEST(test_home_clock_wakes_once_per_second);
+    return UNITY_END();
+}
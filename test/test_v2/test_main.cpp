@@ -0,0 +1,227 @@
+#include <unity.h>
+
+#include "global_vars.h"
+#include "loopback_transport.h"
+#include "server.h"
+#include "tasks.h"
+
+// ============================================================================
+//   Protocol v2
+//   16-bit lengths let requests and responses exceed 255 bytes. A response
+//   larger than the transmit buffer is streamed as chunks, all but the last
+//   with CHUNK_MORE set; a status frame ends the response early. v1 keeps
+//   answering BUFFER_OVERFLOW.
+// ============================================================================
+#define ALARMS_RESPONSE_LEN (3 + 4 * MAX_ALARMS) // SET_ALARMS, 2-byte length, alarms
+
+static LoopbackTransport link;
+
+struct Response {
+    size_t length;    // Bytes of all the frames
+    int frames;
+    bool moreOnAllButLast;
+    bool lastHasMore;
+    byte payload[ALARMS_RESPONSE_LEN + 256];
+};
+
+// Drop the link, then CONNECTED with `magic` (0: none, stays v1), in v1 framing
+static void connect(byte magic) {
+    byte hello[] = {2, CONNECTED, magic};
+    byte payload[8];
+
+    link.attached = false;
+    execRequest(); // Back to v1
+    link.attached = true;
+    link.reset();
+    if (magic == 0) hello[0] = 1;
+    link.send(hello, 1 + hello[0]);
+    execRequest();
+    if (magic != 0) {
+        TEST_ASSERT_EQUAL_INT(2, takeFrame(link, PROTOCOL_V1, payload));
+        TEST_ASSERT_EQUAL_HEX8(SET_PROTOCOL_VERSION, payload[0]);
+    }
+    link.discard();
+}
+
+static void send(byte version, const byte *payload, uint16_t length) {
+    static byte frame[1024];
+    link.send(frame, buildFrame(frame, version, 0, payload, length));
+    execRequest();
+}
+
+// Collect the frames of one response, up to the first one without CHUNK_MORE
+static void takeResponse(Response &response) {
+    byte frame[256];
+    bool more = true;
+    int length;
+
+    response.length = 0;
+    response.frames = 0;
+    response.moreOnAllButLast = true;
+    while (more && (length = takeFrame(link, PROTOCOL_V2, frame, NULL, &more)) >= 0) {
+        TEST_ASSERT_TRUE(response.length + length <= sizeof(response.payload));
+        memcpy(response.payload + response.length, frame, length);
+        response.length += length;
+        response.frames++;
+        if (!more) break;
+    }
+    response.lastHasMore = more;
+}
+
+void setUp() {
+    memset(&eeprom, 0, sizeof(eeprom));
+    eeprom.state = 1;
+    eeprom.alarmCount = MAX_ALARMS;
+    for (uint16_t i = 0; i < MAX_ALARMS; i++) eeprom.alarms[i] = packAlarm(i % 24, i % 60, 1 + i % 30, 0xFF);
+    for (byte i = 0; i < PASSWORD_LEN; i++) eeprom.password[i] = 0xA0 + i;
+    compileSchedule();
+    connect(PROTOCOL_V2_MAGIC);
+}
+
+void tearDown() {}
+
+void test_large_response_is_chunked() {
+    const byte request[] = {GET_ALARMS};
+    static Response response;
+
+    send(PROTOCOL_V2, request, sizeof(request));
+    takeResponse(response);
+
+    TEST_ASSERT_GREATER_THAN(1, response.frames);
+    TEST_ASSERT_TRUE(response.moreOnAllButLast);
+    TEST_ASSERT_FALSE(response.lastHasMore);
+    TEST_ASSERT_EQUAL_UINT32(ALARMS_RESPONSE_LEN, response.length);
+    TEST_ASSERT_EQUAL_UINT32(0, link.received());
+
+    TEST_ASSERT_EQUAL_HEX8(SET_ALARMS, response.payload[0]);
+    TEST_ASSERT_EQUAL_UINT16(4 * MAX_ALARMS, response.payload[1] | response.payload[2] << 8);
+    for (uint16_t i = 0; i < MAX_ALARMS; i++) {
+        const byte *alarm = response.payload + 3 + 4 * i;
+        TEST_ASSERT_EQUAL_UINT8(alarmHour(eeprom.alarms[i]), alarm[0]);
+        TEST_ASSERT_EQUAL_UINT8(alarmMinute(eeprom.alarms[i]), alarm[1]);
+        TEST_ASSERT_EQUAL_UINT8(alarmDuration(eeprom.alarms[i]), alarm[2]);
+        TEST_ASSERT_EQUAL_UINT8(alarmDays(eeprom.alarms[i]), alarm[3]);
+    }
+}
+
+// One request over 255 bytes; a description over 255 bytes is parsed with
+// its 16-bit length and rejected without losing the stream
+void test_long_requests() {
+    byte request[512];
+    byte payload[256];
+    uint16_t length = 0;
+
+    request[length++] = POST_PASSWORD;
+    for (byte i = 0; i < PASSWORD_LEN; i++) request[length++] = eeprom.password[i];
+    request[length++] = SET_DESCRIPTION;
+    request[length++] = MAX_DESCRIPTION_LEN;
+    request[length++] = 0;
+    for (byte i = 0; i < MAX_DESCRIPTION_LEN; i++) request[length++] = 'a' + i % 26;
+    request[length++] = SET_AUTHOR;
+    request[length++] = MAX_AUTHOR_LEN;
+    request[length++] = 0;
+    for (byte i = 0; i < MAX_AUTHOR_LEN; i++) request[length++] = 'A' + i % 26;
+    request[length++] = SET_DESCRIPTION;
+    request[length++] = MAX_DESCRIPTION_LEN;
+    request[length++] = 0;
+    for (byte i = 0; i < MAX_DESCRIPTION_LEN; i++) request[length++] = 'z' - i % 26;
+    TEST_ASSERT_GREATER_THAN(255, length);
+
+    send(PROTOCOL_V2, request, length);
+    TEST_ASSERT_EQUAL_INT(2, takeFrame(link, PROTOCOL_V2, payload));
+    TEST_ASSERT_EQUAL_HEX8(POST_PASSWORD_RESPONSE, payload[0]);
+    TEST_ASSERT_EQUAL_HEX8(PASSWORD_RESPONSE_CORRECT, payload[1]);
+    TEST_ASSERT_EQUAL_UINT8(MAX_DESCRIPTION_LEN, eeprom.descriptionLength);
+    TEST_ASSERT_EQUAL_UINT8('z', eeprom.description[0]);
+    TEST_ASSERT_EQUAL_UINT8(MAX_AUTHOR_LEN, eeprom.authorLength);
+
+    const uint16_t tooLong = 300;
+    length = 0;
+    request[length++] = POST_PASSWORD;
+    for (byte i = 0; i < PASSWORD_LEN; i++) request[length++] = eeprom.password[i];
+    request[length++] = SET_DESCRIPTION;
+    request[length++] = tooLong & 0xFF;
+    request[length++] = tooLong >> 8;
+    for (uint16_t i = 0; i < tooLong; i++) request[length++] = '!';
+
+    send(PROTOCOL_V2, request, length);
+    TEST_ASSERT_EQUAL_INT(1, takeFrame(link, PROTOCOL_V2, payload));
+    TEST_ASSERT_EQUAL_HEX8(BAD_REQUEST, payload[0]);
+    TEST_ASSERT_EQUAL_UINT8(MAX_DESCRIPTION_LEN, eeprom.descriptionLength);
+    TEST_ASSERT_EQUAL_UINT8('z', eeprom.description[0]);
+
+    // The next request is still framed correctly
+    const byte next[] = {GET_DESCRIPTION};
+    send(PROTOCOL_V2, next, sizeof(next));
+    TEST_ASSERT_EQUAL_INT(3 + MAX_DESCRIPTION_LEN, takeFrame(link, PROTOCOL_V2, payload));
+    TEST_ASSERT_EQUAL_HEX8(SET_DESCRIPTION, payload[0]);
+    TEST_ASSERT_EQUAL_UINT16(MAX_DESCRIPTION_LEN, payload[1] | payload[2] << 8);
+}
+
+// A v1 client cannot take chunks: it still gets BUFFER_OVERFLOW
+void test_v1_keeps_buffer_overflow() {
+    const byte request[] = {GET_ALARMS};
+    byte payload[256];
+
+    connect(0);
+    send(PROTOCOL_V1, request, sizeof(request));
+
+    TEST_ASSERT_EQUAL_INT(1, takeFrame(link, PROTOCOL_V1, payload));
+    TEST_ASSERT_EQUAL_HEX8(BUFFER_OVERFLOW, payload[0]);
+}
+
+// A command rejected mid-response: the chunks sent so far are followed by
+// the status frame, which ends the response
+void test_bad_request_closes_chunked_response() {
+    const uint16_t count = ALARMS_PAGE_SIZE + 8;
+    byte request[512];
+    uint16_t length = 0;
+
+    request[length++] = GET_ALARMS;
+
+    // Page 0 is skipped for lack of authorization, so page 1 comes out of order
+    for (byte page = 0; page < 2; page++) {
+        byte n = page == 0 ? ALARMS_PAGE_SIZE : count - ALARMS_PAGE_SIZE;
+        if (page == 1) {
+            request[length++] = POST_PASSWORD;
+            for (byte i = 0; i < PASSWORD_LEN; i++) request[length++] = eeprom.password[i];
+        }
+        request[length++] = SET_ALARMS_PAGE;
+        request[length++] = page;
+        request[length++] = count & 0xFF;
+        request[length++] = count >> 8;
+        request[length++] = n;
+        for (byte i = 0; i < n; i++) {
+            Alarm alarm = packAlarm(6, i, 5, 0xFF);
+            memcpy(request + length, &alarm, sizeof(alarm));
+            length += sizeof(alarm);
+        }
+    }
+
+    static Response response;
+    send(PROTOCOL_V2, request, length);
+    takeResponse(response);
+
+    TEST_ASSERT_GREATER_THAN(1, response.frames);
+    TEST_ASSERT_TRUE(response.moreOnAllButLast);
+    TEST_ASSERT_FALSE(response.lastHasMore);
+    TEST_ASSERT_EQUAL_UINT32(0, link.received());
+
+    // GET_ALARMS and the password response, then the status frame alone
+    TEST_ASSERT_EQUAL_UINT32(ALARMS_RESPONSE_LEN + 2 + 1, response.length);
+    TEST_ASSERT_EQUAL_HEX8(POST_PASSWORD_RESPONSE, response.payload[ALARMS_RESPONSE_LEN]);
+    TEST_ASSERT_EQUAL_HEX8(BAD_REQUEST, response.payload[response.length - 1]);
+    TEST_ASSERT_EQUAL_UINT16(MAX_ALARMS, eeprom.alarmCount);
+}
+
+int main() {
+    startTasks(); // Queues only: the tasks never run on the host
+    registerTransport(link);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_large_response_is_chunked);
+    RUN_TEST(test_long_requests);
+    RUN_TEST(test_v1_keeps_buffer_overflow);
+    RUN_TEST(test_bad_request_closes_chunked_response);
+    return UNITY_END();
+}